@@ -7,11 +7,24 @@
 
 #include <stdlib.h>
 
+// Evaluated arguments stored in SmArgValues itself: calls with more spill
+// to the C heap
+#define SM_ARG_VALUES_INLINE_SIZE 8
+
 typedef struct SmArgPatternArg {
     SmSymbol id;
     bool eval;
 } SmArgPatternArg;
 
+// How arguments are matched to a pattern, chosen once when the pattern is
+// built. Fixed plans bind proper lists of the right length in one pass;
+// anything else, dotted argument lists included, takes the general path
+typedef enum SmArgPlan {
+    SmArgPlanGeneral = 0,   // Fixed arguments followed by a rest argument
+    SmArgPlanFixed,         // Fixed arguments only, with distinct names
+    SmArgPlanRest           // Rest argument only
+} SmArgPlan;
+
 typedef struct SmArgPattern {
     SmString name;
     SmArgPatternArg const* args;
@@ -22,6 +35,8 @@ typedef struct SmArgPattern {
         bool eval;
         bool use;
     } rest;
+
+    SmArgPlan plan;
 } SmArgPattern;
 
 SmError sm_arg_pattern_validate_spec(SmContext* ctx, SmValue spec);
@@ -36,5 +51,29 @@ inline void sm_arg_pattern_drop(SmArgPattern* pattern) {
     pattern->count = 0;
 }
 
+// Arguments evaluated by sm_arg_pattern_eval_values, rooted until
+// sm_arg_values_drop. values[count] holds the final cdr of the argument
+// list: nil unless it is dotted. Must not be moved while rooted
+typedef struct SmArgValues {
+    SmValue* values;
+    size_t count;
+
+    SmHeapRootFrame roots;
+    SmValue local[SM_ARG_VALUES_INLINE_SIZE + 1];
+} SmArgValues;
+
+inline void sm_arg_values_drop(SmContext* ctx, SmArgValues* values) {
+    sm_heap_root_frame_pop(&ctx->heap, &values->roots);
+
+    if (values->values != values->local)
+        free(values->values);
+
+    values->values = NULL;
+    values->count = 0;
+}
+
 SmError sm_arg_pattern_eval(SmArgPattern const* pattern, SmContext* ctx, SmValue args, SmValue* ret);
+// Like sm_arg_pattern_eval, without building a list. On failure nothing
+// is left to drop
+SmError sm_arg_pattern_eval_values(SmArgPattern const* pattern, SmContext* ctx, SmValue args, SmArgValues* out);
 SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmScope* scope, SmValue args);
@@ -6,10 +6,34 @@
 
 void sm_register_builtins(SmContext* ctx);
 
+// Builtin operations on evaluated arguments, shared with the bytecode VM
+typedef enum SmBuiltinArith {
+    SmBuiltinAdd,
+    SmBuiltinSub,
+    SmBuiltinMul,
+    SmBuiltinDiv
+} SmBuiltinArith;
+
+typedef enum SmBuiltinCompare {
+    SmBuiltinEq,
+    SmBuiltinNeq,
+    SmBuiltinLt,
+    SmBuiltinLteq,
+    SmBuiltinGt,
+    SmBuiltinGteq
+} SmBuiltinCompare;
+
+// - and / require at least one argument
+SmError sm_apply_arith(SmContext* ctx, SmBuiltinArith op, SmValue const* args, size_t count, SmValue* ret);
+SmError sm_apply_compare(SmContext* ctx, SmBuiltinCompare op, SmValue lhs, SmValue rhs, SmValue* ret);
+SmError sm_apply_car(SmContext* ctx, SmValue list, SmValue* ret);
+SmError sm_apply_cdr(SmContext* ctx, SmValue list, SmValue* ret);
+
 #define SM_BUILTIN_SYMBOL(id) sm_builtin_##id
 
 #define SM_BUILTIN_TABLE(builtin, builtin_op, builtin_var) \
     builtin(gc) \
+    builtin_op(gc_stats, gc-stats) \
     builtin(eval) \
     builtin(print) \
 \
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "error.h"
+#include "util.h"
+#include "value.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct SmContext;
+struct SmScope;
+
+typedef struct SmInstruction {
+    uint8_t op;
+    uint8_t depth;
+    uint16_t count;
+    uint32_t arg;
+} SmInstruction;
+
+// Lambda body compiled for a stack machine. Forms the compiler does not
+// handle are kept as constants and handed back to sm_eval, so are calls
+// to builtins that have been replaced since compilation
+typedef struct SmBytecode {
+    SmInstruction* code;
+    size_t size;
+
+    SmValue* constants;
+    size_t constant_count;
+
+    size_t stack_size;
+} SmBytecode;
+
+inline SmBytecode sm_bytecode(void) {
+    return (SmBytecode){ NULL, 0, NULL, 0, 0 };
+}
+
+inline bool sm_bytecode_is_compiled(SmBytecode const* code) {
+    return code->code != NULL;
+}
+
+inline void sm_bytecode_drop(SmBytecode* code) {
+    free(code->code);
+    free(code->constants);
+    *code = sm_bytecode();
+}
+
+// Constants hold parts of the compiled forms: the owner of the bytecode
+// must mark them during collections. Variables are resolved to slots
+// through the sealed part of scope, which must have the same layout as the
+// scopes the code runs in
+SmBytecode sm_bytecode_compile(struct SmContext* ctx, struct SmScope const* scope, struct SmCons* progn);
+// Calls in tail position are not run: ctx->tail is set and ret holds the
+// call form, to be evaluated by the caller in the same scope
+SmError sm_bytecode_run(SmBytecode const* code, struct SmContext* ctx, SmValue* ret);
@@ -7,6 +7,31 @@
 #include "util.h"
 #include "value.h"
 
+// Default for SmContext.compile_calls
+#define SM_CONTEXT_COMPILE_CALLS 2
+
+// Default for SmContext.max_depth: only the native stack limits nesting
+#define SM_CONTEXT_MAX_DEPTH SIZE_MAX
+
+struct SmContext;
+
+typedef SmError (*SmExternalFunction)(struct SmContext* ctx, SmValue args, SmValue* ret);
+typedef SmError (*SmExternalVariable)(struct SmContext* ctx, SmValue* ret);
+
+// Externals are stored densely, indexed by the slot number assigned to
+// their symbol on first registration. The kind of the symbol tells which
+// member is valid
+typedef union SmExternal {
+    SmExternalFunction function;
+    SmExternalVariable variable;
+} SmExternal;
+
+typedef struct SmExternalTable {
+    SmExternal* slots;
+    size_t size;
+    size_t capacity;
+} SmExternalTable;
+
 typedef struct SmStackFrame {
     struct SmStackFrame* parent;
 
@@ -17,7 +42,7 @@ typedef struct SmStackFrame {
 typedef struct SmContext {
     SmSymbolSet symbols;
 
-    SmRBTree externals;
+    SmExternalTable externals;
 
     SmStackFrame main;
     SmScope globals;
@@ -26,10 +51,32 @@ typedef struct SmContext {
     SmScope* scope;
 
     SmHeap heap;
-} SmContext;
 
-typedef SmError (*SmExternalFunction)(SmContext* ctx, SmValue args, SmValue* ret);
-typedef SmError (*SmExternalVariable)(SmContext* ctx, SmValue* ret);
+    // Compile lambda bodies to bytecode after the tree walker has run them
+    // compile_calls times: closures called once never repay compilation
+    bool bytecode;
+    uint32_t compile_calls;
+
+    // Nesting of external and lambda calls, and the level of the external
+    // call that may hand back a form in tail position (see sm_eval_tail)
+    size_t depth;
+    size_t tail_depth;
+
+    // Nesting of lambda calls, the same in both evaluators. Calls past
+    // max_depth fail with SmErrorStackOverflow
+    size_t call_depth;
+    size_t max_depth;
+
+    // Native stack evaluation may use, 7/8 of the stack size by default.
+    // The limit is set below the stack address where evaluation starts at
+    // depth 0: nesting past it fails with SmErrorStackOverflow instead of
+    // exhausting the stack
+    size_t stack_size;
+    uintptr_t stack_limit;
+
+    // Set when the result of a call is a form to be evaluated in its place
+    bool tail;
+} SmContext;
 
 // Context functions
 SmContext* sm_context(SmGCConfig gc);
@@ -53,5 +100,10 @@ void sm_context_register_variable(SmContext* ctx, SmSymbol id, SmExternalVariabl
 
 void sm_context_unregister_external(SmContext* ctx, SmSymbol id);
 
-SmExternalFunction sm_context_lookup_function(SmContext* ctx, SmSymbol id);
-SmExternalVariable sm_context_lookup_variable(SmContext* ctx, SmSymbol id);
+inline SmExternalFunction sm_context_lookup_function(SmContext* ctx, SmSymbol id) {
+    return (sm_symbol_kind(id) == SmSymbolExternalFunction) ? ctx->externals.slots[sm_symbol_slot(id)].function : NULL;
+}
+
+inline SmExternalVariable sm_context_lookup_variable(SmContext* ctx, SmSymbol id) {
+    return (sm_symbol_kind(id) == SmSymbolExternalVariable) ? ctx->externals.slots[sm_symbol_slot(id)].variable : NULL;
+}
@@ -15,6 +15,7 @@ typedef enum SmErrorCode {
     SmErrorSyntaxError,
     SmErrorLexicalError,
     SmErrorInvalidLiteral,
+    SmErrorStackOverflow,
     SmErrorGeneric,
 
     SmErrorCount
@@ -5,3 +5,8 @@
 #include "value.h"
 
 SmError sm_eval(SmContext* ctx, SmValue form, SmValue* ret);
+
+// For external functions, in place of sm_eval on the form whose value they
+// return: when called by sm_eval, the form is handed back and evaluated
+// there without growing the stack
+SmError sm_eval_tail(SmContext* ctx, SmValue form, SmValue* ret);
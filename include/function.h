@@ -1,6 +1,7 @@
 #pragma once
 
 #include "args.h"
+#include "bytecode.h"
 #include "error.h"
 #include "scope.h"
 #include "value.h"
@@ -10,6 +11,11 @@ typedef struct SmFunction {
     SmArgPattern args;
     SmScope* capture;
     SmCons* progn;
+
+    // Compiled once the tree walker has run the body as many times as the
+    // context asks (see SmContext.compile_calls), macros are never compiled
+    SmBytecode code;
+    uint32_t calls;
 } SmFunction;
 
 // Expects a valid lambda expression (see sm_validate_lambda)
@@ -18,7 +24,8 @@ inline SmFunction sm_function(SmString name, SmScope* capture, SmCons* lambda) {
         false,
         sm_arg_pattern_from_spec(name, lambda->car),
         capture,
-        sm_list_next(lambda)
+        sm_list_next(lambda),
+        sm_bytecode(), 0
     };
 }
 
@@ -28,15 +35,25 @@ inline SmFunction sm_macro(SmString name, SmScope* capture, SmCons* lambda) {
         true,
         sm_arg_pattern_from_spec(name, lambda->car),
         capture,
-        sm_list_next(lambda)
+        sm_list_next(lambda),
+        sm_bytecode(), 0
     };
 }
 
 inline void sm_function_drop(SmFunction* function) {
     sm_arg_pattern_drop(&function->args);
+    sm_bytecode_drop(&function->code);
 }
 
-SmError sm_function_invoke(SmFunction const* function, struct SmContext* ctx, SmValue args, SmValue* ret);
+// Bind args to a new scope under the capture of the function, evaluating
+// them in the current scope. The scope is not rooted on return
+SmError sm_function_bind(SmFunction* function, struct SmContext* ctx, SmValue args, SmScope** scope);
+
+// Run the body in the current scope up to its tail: when ctx->tail is set
+// on return, ret holds the last form, still to be evaluated
+SmError sm_function_run(SmFunction* function, struct SmContext* ctx, SmValue* ret);
+
+SmError sm_function_invoke(SmFunction* function, struct SmContext* ctx, SmValue args, SmValue* ret);
 
 // Lambda expression handling
 SmError sm_validate_lambda(struct SmContext* ctx, SmValue expr);
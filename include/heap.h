@@ -6,25 +6,155 @@
 #include <stdint.h>
 
 typedef struct SmGCConfig {
-    size_t object_threshold;
-    uint8_t object_threshold_factor;
-    uint8_t unref_threshold;
+    size_t heap_min;        // Heap size in bytes below which no full collection happens
+    double heap_growth;     // After a full collection, the heap may grow to live bytes times this
+    size_t nursery_size;    // Bytes allocated between minor collections, 0 disables them
 } SmGCConfig;
 
+// Collector pacing as of the last collection and since then
+typedef struct SmGCPacing {
+    size_t live_bytes;      // Bytes surviving the last full collection
+    size_t allocated_bytes; // Bytes allocated since the last full collection
+    size_t heap_bytes;      // Bytes currently in allocated objects
+    size_t threshold;       // Heap size triggering the next full collection
+    size_t young_bytes;     // Bytes allocated since the last collection of any kind
+    size_t nursery_size;    // Young bytes triggering the next minor collection, 0 if disabled
+} SmGCPacing;
+
+// Object types, as counted by SmGCStats
+typedef enum SmHeapObjectType {
+    SmHeapObjectSymbol = 0,
+    SmHeapObjectCons,
+    SmHeapObjectScope,
+    SmHeapObjectFunction,
+    SmHeapObjectString
+} SmHeapObjectType;
+
+#define SM_HEAP_OBJECT_TYPE_COUNT 5
+
+// Pauses are counted in power of two buckets of nanoseconds
+#define SM_GC_PAUSE_BUCKETS 64
+
+// Cumulative collector statistics
+typedef struct SmGCStats {
+    size_t collections;         // Full collections
+    size_t minor_collections;
+    uint64_t pause_total_ns;
+    uint64_t pause_max_ns;
+    size_t pauses[SM_GC_PAUSE_BUCKETS]; // Pauses in [2^i, 2^(i+1)) ns
+
+    size_t allocated_objects[SM_HEAP_OBJECT_TYPE_COUNT];
+    size_t allocated_bytes[SM_HEAP_OBJECT_TYPE_COUNT];
+    size_t freed_objects;
+    size_t freed_bytes;
+
+    size_t marked_objects;
+    size_t marked_edges;        // References followed while marking
+    size_t roots_scanned;
+} SmGCStats;
+
+// Summary of a single collection, passed to SmGCCallback
+typedef struct SmGCEvent {
+    bool minor;
+    uint64_t pause_ns;
+    size_t marked_objects;
+    size_t marked_edges;
+    size_t roots_scanned;
+    size_t freed_objects;
+    size_t freed_bytes;
+} SmGCEvent;
+
+struct SmHeap;
+
+// Called after every collection. Must not allocate from the heap
+typedef void (*SmGCCallback)(struct SmHeap const* heap, SmGCEvent const* event, void* data);
+
+// Object types with a fixed size, power of two string sizes, large strings
+#define SM_HEAP_CLASS_COUNT 13
+
+typedef struct SmHeapClass {
+    struct SmHeapChunk* current;    // Chunk we are allocating from
+    struct SmHeapChunk* available;  // Chunks with free slots
+    struct SmHeapChunk* full;       // Chunks without free slots
+    struct SmHeapChunk* nursery;    // Chunks allocated from since the last collection
+    struct SmHeapChunk* unswept;    // Chunks awaiting lazy sweep
+} SmHeapClass;
+
+// Maps chunk-aligned addresses to the chunk covering them
+typedef struct SmHeapPageTable {
+    struct SmHeapPage* entries;
+    size_t capacity;
+    size_t count;
+} SmHeapPageTable;
+
+// Old objects that may hold references to young ones
+typedef struct SmHeapRememberedSet {
+    void const** objects;
+    size_t size;
+    size_t capacity;
+} SmHeapRememberedSet;
+
+// Entries per mark stack segment, override at build time to tune the
+// mark phase
+#ifndef SM_HEAP_MARK_SEGMENT
+#define SM_HEAP_MARK_SEGMENT 4096
+#endif
+
+// Grey objects awaiting tracing, kept in a linked list of fixed size
+// segments. The spare segment is kept across collections
+typedef struct SmHeapMarkStack {
+    struct SmHeapMarkSegment* top;
+    struct SmHeapMarkSegment* spare;
+} SmHeapMarkStack;
+
+// Values rooted by the caller, usually in an array on the native stack.
+// Frames are pushed and popped in LIFO order
+typedef struct SmHeapRootFrame {
+    struct SmHeapRootFrame* parent;
+    SmValue* values;
+    size_t count;
+} SmHeapRootFrame;
+
+// Roots handed out by sm_heap_root and sm_heap_root_value, kept in a stack
+// of fixed size blocks so that pointers to them stay valid. The spare
+// block avoids allocations when the stack oscillates around a block edge
+typedef struct SmHeapRootStack {
+    struct SmHeapRootBlock* top;
+    struct SmHeapRootBlock* spare;
+    SmHeapRootFrame* frames;
+} SmHeapRootStack;
+
 typedef struct SmHeap {
-    struct SmHeapObject* objects;
-    struct SmHeapRoot* roots;
+    SmHeapPageTable pages;
+    SmHeapClass classes[SM_HEAP_CLASS_COUNT];
+    SmHeapRememberedSet remembered;
+    SmHeapMarkStack marks;
+    SmHeapRootStack roots;
 
     struct SmGCStatus {
         SmGCConfig config;
         size_t object_count;
-        size_t object_threshold;
-        size_t unref_count;
+        size_t bytes;
+        size_t live_bytes;
+        size_t allocated_bytes;
+        size_t threshold;
+        size_t young_bytes;
     } gc;
+
+    SmGCStats stats;
+
+    struct SmGCHook {
+        SmGCCallback fn;
+        void* data;
+    } hook;
 } SmHeap;
 
 inline SmHeap sm_heap(SmGCConfig gc) {
-    return (SmHeap){ NULL, NULL, { gc, 0, gc.object_threshold, 0 } };
+    return (SmHeap){
+        { NULL, 0, 0 }, { { NULL, NULL, NULL, NULL, NULL } }, { NULL, 0, 0 }, { NULL, NULL }, { NULL, NULL, NULL },
+        { gc, 0, 0, 0, 0, gc.heap_min, 0 },
+        { 0 }, { NULL, NULL }
+    };
 }
 
 void sm_heap_drop(SmHeap* heap);
@@ -33,8 +163,30 @@ inline size_t sm_heap_size(SmHeap const* heap) {
     return heap->gc.object_count;
 }
 
+// Heap size in bytes triggering the next full collection
 inline size_t sm_heap_threshold(SmHeap const* heap) {
-    return heap->gc.object_threshold;
+    return heap->gc.threshold;
+}
+
+inline SmGCStats const* sm_heap_stats(SmHeap const* heap) {
+    return &heap->stats;
+}
+
+// Upper bound of the pause time under which the given fraction of
+// collections completed, e.g. 0.99 for the 99th percentile
+uint64_t sm_gc_stats_pause_percentile(SmGCStats const* stats, double fraction);
+
+inline void sm_heap_set_gc_callback(SmHeap* heap, SmGCCallback fn, void* data) {
+    heap->hook = (struct SmGCHook){ fn, data };
+}
+
+inline SmGCPacing sm_heap_pacing(SmHeap const* heap) {
+    struct SmGCStatus const* gc = &heap->gc;
+
+    return (SmGCPacing){
+        gc->live_bytes, gc->allocated_bytes, gc->bytes,
+        gc->threshold, gc->young_bytes, gc->config.nursery_size
+    };
 }
 
 bool sm_heap_is_managed(SmHeap const* heap, void const* ptr);
@@ -44,12 +196,37 @@ SmCons* sm_heap_alloc_cons(SmHeap* heap, struct SmContext const* ctx);
 struct SmScope* sm_heap_alloc_scope(SmHeap* heap, struct SmContext const* ctx);
 struct SmFunction* sm_heap_alloc_function(SmHeap* heap, struct SmContext const* ctx);
 char* sm_heap_alloc_string(SmHeap* heap, struct SmContext const* ctx, size_t length);
+// Copy str into a new string value. str must stay reachable if it points
+// into the heap
+SmStringHeader const* sm_heap_alloc_string_value(SmHeap* heap, struct SmContext const* ctx, SmString str);
 
 void** sm_heap_root(SmHeap* heap);
 SmValue* sm_heap_root_value(SmHeap* heap);
+// Dropping a root never triggers a collection, ctx is kept for compatibility
 void sm_heap_root_drop(SmHeap* heap, struct SmContext const* ctx, void** root);
 void sm_heap_root_value_drop(SmHeap* heap, struct SmContext const* ctx, SmValue* root);
 
-void sm_heap_unref(SmHeap* heap, struct SmContext const* ctx, size_t count);
+// Root an array of values provided by the caller, which are set to nil.
+// Frames must be popped in reverse order
+inline void sm_heap_root_frame_push(SmHeap* heap, SmHeapRootFrame* frame, SmValue* values, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        values[i] = sm_value_nil();
+
+    *frame = (SmHeapRootFrame){ heap->roots.frames, values, count };
+    heap->roots.frames = frame;
+}
+
+inline void sm_heap_root_frame_pop(SmHeap* heap, SmHeapRootFrame* frame) {
+    sm_assert(heap->roots.frames == frame);
+    heap->roots.frames = frame->parent;
+}
+
+// Must be called after storing a reference into a managed object, before
+// the next allocation. ptr may point anywhere inside the object
+void sm_heap_write_barrier(SmHeap* heap, void const* ptr);
 
 void sm_heap_gc(SmHeap* heap, struct SmContext const* ctx);
+
+// Write barriers only remember objects when nursery_size is not 0: without
+// a nursery this falls back to a full collection
+void sm_heap_gc_minor(SmHeap* heap, struct SmContext const* ctx);
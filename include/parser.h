@@ -5,6 +5,7 @@
 #include "value.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 
 typedef struct SmSourceLoc {
     size_t index;
@@ -17,14 +18,58 @@ typedef struct SmParser {
     SmString source;
 
     SmSourceLoc location;
+
+    // Source may continue past its end, as with reader chunks: tokens
+    // reaching the end are truncated instead of being interned
+    bool partial;
 } SmParser;
 
 inline SmParser sm_parser(SmString name, SmString source) {
-    return (SmParser){ name, source, { 0, 1, 1 } };
+    return (SmParser){ name, source, { 0, 1, 1 }, false };
+}
+
+// Stores up to size bytes of source into buf, returns how many. 0 means
+// end of input, or a failure the caller of the reader must check for
+typedef size_t (*SmReaderFunction)(void* data, char* buf, size_t size);
+
+// Initial size of reader buffers
+#define SM_READER_BUFFER_SIZE (64 << 10)
+
+// Source read in chunks. The buffer only holds the form being parsed and
+// what is left of the last chunk, growing for forms larger than that
+typedef struct SmReader {
+    SmReaderFunction read;
+    void* data;
+
+    char* buf;
+    size_t capacity;
+    bool end;
+
+    // buf maps the whole source, there is nothing to read
+    bool mapped;
+} SmReader;
+
+inline SmReader sm_reader(SmReaderFunction read, void* data) {
+    return (SmReader){ read, data, NULL, 0, false, false };
 }
 
+void sm_reader_drop(SmReader* reader);
+
+// SmReaderFunction for FILE streams: check ferror at the end of input
+size_t sm_reader_read_file(void* file, char* buf, size_t size);
+
+// Parse file in place from a read-only mapping, where supported. Returns
+// false and leaves reader unchanged when file cannot be mapped (e.g. pipes
+// or empty files): read it instead
+bool sm_reader_map_file(SmReader* reader, FILE* file);
+
 bool sm_parser_finished(SmParser* parser);
 SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form);
 SmError sm_parser_parse_all(SmParser* parser, SmContext* ctx, SmValue* list);
 
+// Parse the next top-level form, reading from reader as needed. The source
+// of parser must be empty on the first call, then it is managed here. done
+// is set at the end of input, when form is nil
+SmError sm_parser_parse_next(SmParser* parser, SmReader* reader, SmContext* ctx, SmValue* form, bool* done);
+
 bool sm_can_parse_float(SmString str);
@@ -6,44 +6,155 @@
 #include "value.h"
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
-typedef struct SmScope {
-    struct SmScope* parent;
-    SmRBTree vars;
-} SmScope;
+// Variables stored in the scope object itself: calls with this many
+// arguments or fewer need no allocation besides the scope
+#define SM_SCOPE_INLINE_SIZE 4
 
 typedef struct SmVariable {
     SmSymbol id;
     SmValue value;
 } SmVariable;
 
+// Local scopes keep variables in a flat array, in binding order, so that
+// compiled code can address them by slot. The array starts inline and
+// spills to the C heap when it outgrows it. Once sealed they gain no new
+// names: deleted variables keep their slot with a NULL id. Dynamic scopes
+// (the global one) may gain names at any time and index them by a tree
+typedef struct SmScope {
+    struct SmScope* parent;
+
+    SmVariable* spill;
+    size_t size;
+    size_t capacity;
+
+    bool sealed;
+    SmRBTree* vars;
+
+    SmVariable local[SM_SCOPE_INLINE_SIZE];
+} SmScope;
+
 inline SmScope sm_scope(SmScope* parent) {
     return (SmScope) {
         parent,
-        sm_rbtree(sizeof(SmVariable), sm_alignof(SmVariable), sm_symbol_key, sm_key_compare_ptr)
+        NULL, 0, SM_SCOPE_INLINE_SIZE,
+        false, NULL,
+        { { NULL, sm_value_nil() } }
     };
 }
 
+inline SmScope sm_scope_dynamic(SmScope* parent) {
+    SmScope scope = sm_scope(parent);
+
+    scope.vars = malloc(sizeof(SmRBTree));
+    sm_guard(scope.vars != NULL, "allocation failed");
+    *scope.vars = sm_rbtree(sizeof(SmVariable), sm_alignof(SmVariable), sm_symbol_key, sm_key_compare_ptr);
+
+    return scope;
+}
+
 inline void sm_scope_drop(SmScope* scope) {
     scope->parent = NULL;
-    sm_rbtree_drop(&scope->vars);
+
+    free(scope->spill);
+    scope->spill = NULL;
+    scope->size = 0;
+    scope->capacity = SM_SCOPE_INLINE_SIZE;
+
+    if (scope->vars) {
+        sm_rbtree_drop(scope->vars);
+        free(scope->vars);
+        scope->vars = NULL;
+    }
+}
+
+// Local scopes only: declare that no more names will be added
+inline void sm_scope_seal(SmScope* scope) {
+    scope->sealed = !scope->vars;
+}
+
+// Local scopes only: the array of variables, valid until the next one is added
+inline SmVariable* sm_scope_slots(SmScope const* scope) {
+    return scope->spill ? scope->spill : (SmVariable*) scope->local;
+}
+
+inline SmVariable* sm_scope_slot(SmScope const* scope, size_t index) {
+    sm_assert(!scope->vars && index < scope->size);
+    return &sm_scope_slots(scope)[index];
 }
 
 inline size_t sm_scope_size(SmScope const* scope) {
-    return sm_rbtree_size(&scope->vars);
+    if (scope->vars)
+        return sm_rbtree_size(scope->vars);
+
+    SmVariable const* slots = sm_scope_slots(scope);
+    size_t size = 0;
+    for (size_t i = 0; i < scope->size; ++i)
+        size += (slots[i].id != NULL);
+
+    return size;
 }
 
 inline SmVariable* sm_scope_get(SmScope const* scope, SmSymbol id) {
-    return (SmVariable*) sm_rbtree_find_by_key(&scope->vars, sm_symbol_key(&id));
+    if (scope->vars)
+        return (SmVariable*) sm_rbtree_find_by_key(scope->vars, sm_symbol_key(&id));
+
+    // Deleted slots have a NULL id and never match
+    SmVariable* slots = sm_scope_slots(scope);
+    for (size_t i = 0; i < scope->size; ++i) {
+        if (slots[i].id == id)
+            return &slots[i];
+    }
+
+    return NULL;
 }
 
+// Local scopes only: add a variable that is not bound yet. This may move
+// the others
+inline SmVariable* sm_scope_add(SmScope* scope, SmSymbol id, SmValue value) {
+    sm_assert(!scope->vars && !scope->sealed);
+
+    if (scope->size == scope->capacity) {
+        SmVariable* spill = realloc(scope->spill, 2*scope->capacity*sizeof(SmVariable));
+        sm_guard(spill != NULL, "allocation failed");
+
+        if (!scope->spill)
+            memcpy(spill, scope->local, sizeof(scope->local));
+
+        scope->spill = spill;
+        scope->capacity *= 2;
+    }
+
+    SmVariable* slots = sm_scope_slots(scope);
+    slots[scope->size] = (SmVariable){ id, value };
+    return &slots[scope->size++];
+}
+
+// Adding a variable to a local scope may move the others
 inline SmVariable* sm_scope_set(SmScope* scope, SmSymbol id, SmValue value) {
-    SmVariable var = { id, value };
-    return (SmVariable*) sm_rbtree_insert(&scope->vars, &var);
+    if (scope->vars) {
+        SmVariable var = { id, value };
+        return (SmVariable*) sm_rbtree_insert(scope->vars, &var);
+    }
+
+    SmVariable* slot = sm_scope_get(scope, id);
+    if (slot) {
+        slot->value = value;
+        return slot;
+    }
+
+    return sm_scope_add(scope, id, value);
 }
 
 inline void sm_scope_delete(SmScope* scope, SmSymbol id) {
-    sm_rbtree_erase(&scope->vars, sm_rbtree_find_by_key(&scope->vars, sm_symbol_key(&id)));
+    SmVariable* var = sm_scope_get(scope, id);
+
+    if (scope->vars)
+        sm_rbtree_erase(scope->vars, var);
+    else if (var)
+        *var = (SmVariable){ NULL, sm_value_nil() };
 }
 
 inline bool sm_scope_is_set(SmScope const* scope, SmSymbol id) {
@@ -51,11 +162,28 @@ inline bool sm_scope_is_set(SmScope const* scope, SmSymbol id) {
 }
 
 inline SmVariable* sm_scope_first(SmScope const* scope) {
-    return (SmVariable*) sm_rbtree_first(&scope->vars);
+    if (scope->vars)
+        return (SmVariable*) sm_rbtree_first(scope->vars);
+
+    SmVariable* slots = sm_scope_slots(scope);
+    for (size_t i = 0; i < scope->size; ++i) {
+        if (slots[i].id)
+            return &slots[i];
+    }
+
+    return NULL;
 }
 
 inline SmVariable* sm_scope_next(SmScope const* scope, SmVariable* var) {
-    return (SmVariable*) sm_rbtree_next(&scope->vars, var);
+    if (scope->vars)
+        return (SmVariable*) sm_rbtree_next(scope->vars, var);
+
+    for (++var; var < sm_scope_slots(scope) + scope->size; ++var) {
+        if (var->id)
+            return var;
+    }
+
+    return NULL;
 }
 
 inline SmVariable* sm_scope_lookup(SmScope const* scope, SmSymbol id) {
@@ -68,3 +196,16 @@ inline SmVariable* sm_scope_lookup(SmScope const* scope, SmSymbol id) {
 
     return var;
 }
+
+// Like sm_scope_lookup, also report the scope holding the variable
+inline SmVariable* sm_scope_lookup_owner(SmScope* scope, SmSymbol id, SmScope** owner) {
+    SmVariable* var = NULL;
+
+    for (; scope; scope = scope->parent) {
+        if ((var = sm_scope_get(scope, id)))
+            break;
+    }
+
+    *owner = scope;
+    return var;
+}
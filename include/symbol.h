@@ -1,27 +1,91 @@
 #pragma once
 
-#include "rbtree.h"
 #include "util.h"
 
 #include <stdint.h>
 
 // Types
 typedef void const* SmSymbol;
-typedef SmRBTree SmSymbolSet;
+
+// Classification cached on symbols for the evaluator: nil and keywords
+// are recognized at intern time, externals when they are registered
+typedef enum SmSymbolKind {
+    SmSymbolPlain,
+    SmSymbolNil,
+    SmSymbolKeyword,
+    SmSymbolExternalFunction,
+    SmSymbolExternalVariable
+} SmSymbolKind;
+
+// Symbols point to this header. Symbols not obtained from a set (e.g.
+// private markers) must have the same layout. The slot indexes the
+// externals table of the owning context, 0 means none
+typedef struct SmSymbolHeader {
+    SmString str;
+    uint32_t hash;
+    uint32_t kind;
+    uint32_t slot;
+} SmSymbolHeader;
+
+// Bump allocator for symbol names, which live as long as their set
+typedef struct SmSymbolArena {
+    struct SmSymbolArenaBlock* blocks;
+    char* top;
+    char* end;
+} SmSymbolArena;
+
+// Open addressing hash set of symbol names. Hashes are kept apart from
+// names, which probing only reads when hashes match; 0 marks an empty
+// slot. Probing is scalar: at load 1/2 or less most names sit in their
+// home slot, where comparing hashes in SIMD groups measured slower
+typedef struct SmSymbolSet {
+    uint32_t* hashes;
+    struct SmSymbolName** names;
+    size_t capacity;
+    size_t size;
+    SmSymbolArena arena;
+} SmSymbolSet;
 
 // Symbol set functions
-#define sm_symbol_set sm_string_rbtree
-#define sm_symbol_set_size sm_rbtree_size
-#define sm_symbol_set_first sm_rbtree_first
-#define sm_symbol_set_next sm_rbtree_next
+inline SmSymbolSet sm_symbol_set(void) {
+    return (SmSymbolSet){ NULL, NULL, 0, 0, { NULL, NULL, NULL } };
+}
 
 void sm_symbol_set_drop(SmSymbolSet* set);
 
+inline size_t sm_symbol_set_size(SmSymbolSet const* set) {
+    return set->size;
+}
+
+// Iterate over symbols in unspecified order
+SmSymbol sm_symbol_set_first(SmSymbolSet const* set);
+SmSymbol sm_symbol_set_next(SmSymbolSet const* set, SmSymbol symbol);
+
 // Symbol functions
 SmSymbol sm_symbol(SmSymbolSet* set, SmString str);
 
+// Header for a plain symbol kept outside any set, hashed like interned ones
+SmSymbolHeader sm_symbol_header(SmString str);
+
 inline SmString sm_symbol_str(SmSymbol symbol) {
-    return *(SmString const*) symbol;
+    return ((SmSymbolHeader const*) symbol)->str;
+}
+
+inline SmSymbolKind sm_symbol_kind(SmSymbol symbol) {
+    return (SmSymbolKind) ((SmSymbolHeader const*) symbol)->kind;
+}
+
+inline uint32_t sm_symbol_slot(SmSymbol symbol) {
+    return ((SmSymbolHeader const*) symbol)->slot;
+}
+
+// Only meant for symbols interned in a set
+inline void sm_symbol_set_kind(SmSymbol symbol, SmSymbolKind kind) {
+    ((SmSymbolHeader*) symbol)->kind = kind;
+}
+
+inline void sm_symbol_set_slot(SmSymbol symbol, uint32_t slot) {
+    ((SmSymbolHeader*) symbol)->slot = slot;
 }
 
 #define sm_symbol_key sm_ptr_key
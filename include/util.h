@@ -44,6 +44,15 @@
 
 #endif
 
+// Keep bulky paths out of hot callers
+#if defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER)
+    #define sm_noinline __attribute__((noinline))
+#elif defined(_MSC_VER)
+    #define sm_noinline __declspec(noinline)
+#else
+    #define sm_noinline
+#endif
+
 // Error handling
 #define sm_panic(...) {sm_handle_panic(__func__, __FILE__, __LINE__, __VA_ARGS__);}
 #define sm_guard(cond, ...) {if (!(cond)) sm_panic(__VA_ARGS__);}
@@ -109,6 +118,61 @@ inline void* sm_aligned_alloc(size_t alignment, size_t size) {
     return ptr;
 }
 
+// Bit manipulation
+inline unsigned int sm_ctz64(uint64_t v) {
+    #if defined(__GNUC__) || defined(__clang__)
+        return v ? (unsigned int) __builtin_ctzll(v) : 64;
+    #else
+        unsigned int c = 0;
+        if (!v)
+            return 64;
+        for (; !(v & 1); v >>= 1)
+            ++c;
+        return c;
+    #endif
+}
+
+inline unsigned int sm_clz64(uint64_t v) {
+    #if defined(__GNUC__) || defined(__clang__)
+        return v ? (unsigned int) __builtin_clzll(v) : 64;
+    #else
+        unsigned int c = 0;
+        if (!v)
+            return 64;
+        for (; !(v & (UINT64_C(1) << 63)); v <<= 1)
+            ++c;
+        return c;
+    #endif
+}
+
+inline unsigned int sm_popcount64(uint64_t v) {
+    #if defined(__GNUC__) || defined(__clang__)
+        return (unsigned int) __builtin_popcountll(v);
+    #else
+        v = v - ((v >> 1) & UINT64_C(0x5555555555555555));
+        v = (v & UINT64_C(0x3333333333333333)) + ((v >> 2) & UINT64_C(0x3333333333333333));
+        v = (v + (v >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+        return (unsigned int) ((v*UINT64_C(0x0101010101010101)) >> 56);
+    #endif
+}
+
+// Monotonic clock in nanoseconds, for measurements only
+uint64_t sm_clock_ns(void);
+
+// Native stack size assumed when the system does not tell, or imposes
+// no limit
+#define SM_STACK_SIZE ((size_t) 8 << 20)
+
+// Size of the native stack of the main thread
+size_t sm_stack_size(void);
+
+// Address near the top of the native stack, in the frame of the caller
+#if defined(__GNUC__) || defined(__clang__)
+    #define sm_stack_address() ((uintptr_t) __builtin_frame_address(0))
+#else
+    #define sm_stack_address() ((uintptr_t) &(char){ 0 })
+#endif
+
 // Testing
 typedef struct SmTestContext {
     size_t pass;
@@ -15,7 +15,8 @@ typedef enum SmType {
     SmTypeSymbol,
     SmTypeString,
     SmTypeCons,
-    SmTypeFunction
+    SmTypeFunction,
+    SmTypeExternal
 } SmType;
 
 typedef enum SmBuildOp {
@@ -25,6 +26,14 @@ typedef enum SmBuildOp {
     SmBuildList
 } SmBuildOp;
 
+// String values point to this header, allocated from the heap along with
+// the characters that follow it. Strings are immutable: their hash is
+// computed once, as sm_hash_str(str, 0), when they are allocated
+typedef struct SmStringHeader {
+    SmString str;
+    uint32_t hash;
+} SmStringHeader;
+
 typedef struct SmValue {
     SmType type;
     uint8_t quotes;
@@ -32,7 +41,7 @@ typedef struct SmValue {
     union {
         SmNumber number;
         SmSymbol symbol;
-        SmString string;
+        SmStringHeader const* string;
         struct SmCons* cons;
         struct SmFunction* function;
     } data;
@@ -57,8 +66,8 @@ inline SmValue sm_value_symbol(SmSymbol symbol) {
     return (SmValue){ SmTypeSymbol, 0, { .symbol = symbol } };
 }
 
-inline SmValue sm_value_string(SmString string) {
-    sm_assert(string.length == 0 || string.data != NULL);
+inline SmValue sm_value_string(SmStringHeader const* string) {
+    sm_assert(string != NULL);
     return (SmValue){ SmTypeString, 0, { .string = string } };
 }
 
@@ -72,6 +81,12 @@ inline SmValue sm_value_function(struct SmFunction* function) {
     return (SmValue){ SmTypeFunction, 0, { .function = function } };
 }
 
+// External functions are referenced through their symbol
+inline SmValue sm_value_external(SmSymbol symbol) {
+    sm_assert(symbol != NULL);
+    return (SmValue){ SmTypeExternal, 0, { .symbol = symbol } };
+}
+
 inline bool sm_value_is_nil(SmValue value) {
     return value.type == SmTypeNil;
 }
@@ -96,6 +111,10 @@ inline bool sm_value_is_function(SmValue value) {
     return value.type == SmTypeFunction;
 }
 
+inline bool sm_value_is_external(SmValue value) {
+    return value.type == SmTypeExternal;
+}
+
 inline bool sm_value_is_quoted(SmValue value) {
     return value.quotes != 0;
 }
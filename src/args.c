@@ -6,10 +6,74 @@
 
 // Inlines
 extern inline void sm_arg_pattern_drop(SmArgPattern* pattern);
+extern inline void sm_arg_values_drop(SmContext* ctx, SmArgValues* values);
 
 // Error message buffer
 static sm_thread_local char err_buf[1024];
 
+// Reject argument lists that do not match pattern
+static SmError check_arguments(SmArgPattern const* pattern, SmContext* ctx, size_t available, SmValue final_cdr) {
+    if (available < pattern->count) {
+        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %s%zu arguments, %zu given",
+            (int) pattern->name.length, pattern->name.data,
+            pattern->rest.use ? "at least " : "", pattern->count, available);
+        return sm_error(ctx, SmErrorMissingArguments, err_buf);
+    } else if (available > pattern->count && !pattern->rest.use) {
+        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %zu arguments, %zu given",
+            (int) pattern->name.length, pattern->name.data,
+            pattern->count, available);
+        return sm_error(ctx, SmErrorExcessArguments, err_buf);
+    } else if (!pattern->rest.use && (!sm_value_is_nil(final_cdr) || sm_value_is_quoted(final_cdr))) {
+        snprintf(err_buf, sizeof(err_buf), "%.*s: cannot accept dotted argument list",
+            (int) pattern->name.length, pattern->name.data);
+        return sm_error(ctx, SmErrorInvalidArgument, err_buf);
+    }
+
+    return sm_ok;
+}
+
+// Fixed plans: whether args is an unquoted proper list of exactly the
+// expected length. Walks no further than that
+static inline bool fixed_match(SmArgPattern const* pattern, SmValue args) {
+    for (size_t i = 0; i < pattern->count; ++i) {
+        if (!sm_value_is_cons(args) || sm_value_is_quoted(args))
+            return false;
+
+        args = args.data.cons->cdr;
+    }
+
+    return sm_value_is_nil(args) && !sm_value_is_quoted(args);
+}
+
+// Fixed plans, once args matched: evaluate in a single pass
+static SmError eval_fixed(SmArgPattern const* pattern, SmContext* ctx, SmValue args, SmArgValues* out) {
+    out->values = out->local;
+    out->count = pattern->count;
+
+    if (pattern->count > SM_ARG_VALUES_INLINE_SIZE) {
+        out->values = malloc((pattern->count + 1)*sizeof(SmValue));
+        sm_guard(out->values != NULL, "allocation failed");
+    }
+
+    sm_heap_root_frame_push(&ctx->heap, &out->roots, out->values, pattern->count + 1);
+
+    SmCons* arg = sm_value_is_cons(args) ? args.data.cons : NULL;
+    for (size_t i = 0; i < pattern->count; ++i, arg = sm_list_next(arg)) {
+        if (!pattern->args[i].eval) {
+            out->values[i] = arg->car;
+            continue;
+        }
+
+        SmError err = sm_eval(ctx, arg->car, &out->values[i]);
+        if (!sm_is_ok(err)) {
+            sm_arg_values_drop(ctx, out);
+            return err;
+        }
+    }
+
+    return sm_ok;
+}
+
 // Argument matching functions
 SmError sm_arg_pattern_validate_spec(SmContext* ctx, SmValue spec) {
     if (!sm_value_is_symbol(spec) && !sm_value_is_list(spec)) {
@@ -37,12 +101,13 @@ SmError sm_arg_pattern_validate_spec(SmContext* ctx, SmValue spec) {
 
 SmArgPattern sm_arg_pattern_from_spec(SmString name, SmValue spec) {
     // Spec *must* be valid, otherwise this is UB. See sm_arg_pattern_validate_spec
-    SmArgPattern pattern = { name, NULL, 0, { NULL, false, false } };
+    SmArgPattern pattern = { name, NULL, 0, { NULL, false, false }, SmArgPlanFixed };
 
     if (sm_value_is_symbol(spec)) {
         pattern.rest.id = spec.data.symbol;
         pattern.rest.eval = !sm_value_is_quoted(spec);
         pattern.rest.use = true;
+        pattern.plan = SmArgPlanRest;
         return pattern;
     }
 
@@ -61,6 +126,17 @@ SmArgPattern sm_arg_pattern_from_spec(SmString name, SmValue spec) {
             pattern.rest.id = arg->cdr.data.symbol;
             pattern.rest.eval = !sm_value_is_quoted(arg->cdr);
             pattern.rest.use = true;
+            pattern.plan = SmArgPlanGeneral;
+        }
+    }
+
+    // Repeated names are bound like set would
+    for (size_t i = 0; i < pattern.count && pattern.plan == SmArgPlanFixed; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (pattern.args[i].id == pattern.args[j].id) {
+                pattern.plan = SmArgPlanGeneral;
+                break;
+            }
         }
     }
 
@@ -96,23 +172,10 @@ SmError sm_arg_pattern_eval(SmArgPattern const* pattern, SmContext* ctx, SmValue
     }
 
     // Reject invalid argument lists
-    if (available < pattern->count) {
-        *ret = sm_value_nil();
-        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %s%zu arguments, %zu given",
-            (int) pattern->name.length, pattern->name.data,
-            pattern->rest.use ? "at least " : "", pattern->count, available);
-        return sm_error(ctx, SmErrorMissingArguments, err_buf);
-    } else if (available > pattern->count && !pattern->rest.use) {
-        *ret = sm_value_nil();
-        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %zu arguments, %zu given",
-            (int) pattern->name.length, pattern->name.data,
-            pattern->count, available);
-        return sm_error(ctx, SmErrorExcessArguments, err_buf);
-    } else if (!pattern->rest.use && (!sm_value_is_nil(final_cdr) || sm_value_is_quoted(final_cdr))) {
+    SmError err = check_arguments(pattern, ctx, available, final_cdr);
+    if (!sm_is_ok(err)) {
         *ret = sm_value_nil();
-        snprintf(err_buf, sizeof(err_buf), "%.*s: cannot accept dotted argument list",
-            (int) pattern->name.length, pattern->name.data);
-        return sm_error(ctx, SmErrorInvalidArgument, err_buf);
+        return err;
     }
 
     // At this point we know input matches the pattern so we can get away
@@ -139,9 +202,14 @@ SmError sm_arg_pattern_eval(SmArgPattern const* pattern, SmContext* ctx, SmValue
     *ret = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
     SmCons* out = ret->data.cons;
 
-    SmError err = sm_ok;
     bool into_dot = false;
 
+    // Evaluate into a root: out may be promoted while evaluating
+    SmValue value_root;
+    SmHeapRootFrame roots;
+    sm_heap_root_frame_push(&ctx->heap, &roots, &value_root, 1);
+    SmValue* value = &value_root;
+
     if (!arg && sm_value_is_cons(*dot_root) && !sm_value_is_quoted(*dot_root)) {
         arg = dot_root->data.cons;
         into_dot = true;
@@ -149,13 +217,18 @@ SmError sm_arg_pattern_eval(SmArgPattern const* pattern, SmContext* ctx, SmValue
 
     for (size_t i = 0; arg; ++i) {
         if (!into_dot && ((i < pattern->count) ? pattern->args[i].eval : pattern->rest.eval)) {
-            err = sm_eval(ctx, arg->car, &out->car);
+            *value = sm_value_nil();
+            err = sm_eval(ctx, arg->car, value);
             if (!sm_is_ok(err))
                 break;
+
+            out->car = *value;
         } else {
             out->car = arg->car;
         }
 
+        sm_heap_write_barrier(&ctx->heap, out);
+
         if (!(arg = sm_list_next(arg)) && !into_dot &&
                 sm_value_is_cons(*dot_root) && !sm_value_is_quoted(*dot_root))
         {
@@ -166,22 +239,158 @@ SmError sm_arg_pattern_eval(SmArgPattern const* pattern, SmContext* ctx, SmValue
 
         if (arg) {
             out->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+            sm_heap_write_barrier(&ctx->heap, out);
             out = out->cdr.data.cons;
         }
     }
 
     out->cdr = final_cdr;
+    sm_heap_write_barrier(&ctx->heap, out);
 
     if (!sm_is_ok(err))
         *ret = sm_value_nil(); // In case of error drop output list
 
+    sm_heap_root_frame_pop(&ctx->heap, &roots);
+
     if (eval_dot)
         sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
 
     return err;
 }
 
+SmError sm_arg_pattern_eval_values(SmArgPattern const* pattern, SmContext* ctx, SmValue args, SmArgValues* out) {
+    if (pattern->plan == SmArgPlanFixed && fixed_match(pattern, args))
+        return eval_fixed(pattern, ctx, args, out);
+
+    SmCons* arg = (sm_value_is_cons(args) && !sm_value_is_quoted(args)) ? args.data.cons : NULL;
+    size_t available = sm_list_size(arg);
+
+    // Keep the dot part in the first slot until the count is known
+    out->values = out->local;
+    out->count = 0;
+    sm_heap_root_frame_push(&ctx->heap, &out->roots, out->local, 1);
+
+    SmValue* dot = &out->local[0];
+    *dot = arg ? sm_list_dot(arg) : args;
+
+    // Eval dot part if we need more arguments or rest says so
+    if (available < pattern->count || (pattern->rest.use && pattern->rest.eval)) {
+        if (!sm_value_is_symbol(*dot) || sm_value_is_quoted(*dot)) {
+            *dot = sm_value_unquote(*dot, 1);
+        } else {
+            SmValue form = *dot;
+            *dot = sm_value_nil();
+
+            SmError err = sm_eval(ctx, form, dot);
+            if (!sm_is_ok(err)) {
+                sm_heap_root_frame_pop(&ctx->heap, &out->roots);
+                return err;
+            }
+        }
+    }
+
+    SmValue final_cdr = *dot;
+    SmCons* dot_list = NULL;
+
+    if (sm_value_is_list(*dot) && !sm_value_is_quoted(*dot)) {
+        dot_list = dot->data.cons;
+        available += sm_list_size(dot_list);
+        final_cdr = sm_list_dot(dot_list);
+    }
+
+    // Reject invalid argument lists
+    SmError err = check_arguments(pattern, ctx, available, final_cdr);
+    if (!sm_is_ok(err)) {
+        sm_heap_root_frame_pop(&ctx->heap, &out->roots);
+        return err;
+    }
+
+    // One more slot keeps the dot part alive, then holds the final cdr
+    if (available > SM_ARG_VALUES_INLINE_SIZE) {
+        out->values = malloc((available + 1)*sizeof(SmValue));
+        sm_guard(out->values != NULL, "allocation failed");
+    }
+
+    out->values[available] = *dot;
+    for (size_t i = 0; i < available; ++i)
+        out->values[i] = sm_value_nil();
+
+    out->roots.values = out->values;
+    out->roots.count = available + 1;
+
+    bool into_dot = false;
+    if (!arg && dot_list) {
+        arg = dot_list;
+        into_dot = true;
+    }
+
+    // Evaluate in place: slots are rooted already
+    for (size_t i = 0; arg; ++i) {
+        if (!into_dot && ((i < pattern->count) ? pattern->args[i].eval : pattern->rest.eval)) {
+            err = sm_eval(ctx, arg->car, &out->values[i]);
+            if (!sm_is_ok(err))
+                break;
+        } else {
+            out->values[i] = arg->car;
+        }
+
+        out->count = i + 1;
+
+        if (!(arg = sm_list_next(arg)) && !into_dot && dot_list) {
+            // If possible, continue taking arguments from dot part
+            arg = dot_list;
+            into_dot = true;
+        }
+    }
+
+    if (!sm_is_ok(err)) {
+        sm_arg_values_drop(ctx, out);
+        return err;
+    }
+
+    out->values[available] = final_cdr;
+    return sm_ok;
+}
+
+// Evaluate every argument before binding any: one write barrier covers
+// them all
+static SmError unpack_fixed(SmArgPattern const* pattern, SmContext* ctx, SmScope* scope, SmValue args) {
+    SmArgValues values;
+    SmError err = eval_fixed(pattern, ctx, args, &values);
+    if (!sm_is_ok(err))
+        return err;
+
+    for (size_t i = 0; i < pattern->count; ++i)
+        sm_scope_add(scope, pattern->args[i].id, values.values[i]);
+
+    sm_heap_write_barrier(&ctx->heap, scope);
+    sm_arg_values_drop(ctx, &values);
+
+    return sm_ok;
+}
+
 SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmScope* scope, SmValue args) {
+    switch (pattern->plan) {
+        case SmArgPlanFixed:
+            // Names are distinct, so they can be added without lookups
+            // as long as scope is empty
+            if (!scope->vars && scope->size == 0 && fixed_match(pattern, args))
+                return unpack_fixed(pattern, ctx, scope, args);
+            break;
+
+        case SmArgPlanRest:
+            // Unevaluated rest arguments take the argument list as is
+            if (!pattern->rest.eval) {
+                sm_scope_set(scope, pattern->rest.id, args);
+                sm_heap_write_barrier(&ctx->heap, scope);
+                return sm_ok;
+            }
+            break;
+
+        case SmArgPlanGeneral:
+            break;
+    }
+
     SmCons* arg = (sm_value_is_cons(args) && !sm_value_is_quoted(args)) ? args.data.cons : NULL;
     size_t available = sm_list_size(arg);
 
@@ -210,27 +419,11 @@ SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmSco
     }
 
     // Reject invalid argument lists
-    if (available < pattern->count) {
-        if (dot_root != &dot)
-            sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
-        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %s%zu arguments, %zu given",
-            (int) pattern->name.length, pattern->name.data,
-            pattern->rest.use ? "at least " : "", pattern->count, available);
-        return sm_error(ctx, SmErrorMissingArguments, err_buf);
-    } else if (available > pattern->count && !pattern->rest.use) {
+    SmError err = check_arguments(pattern, ctx, available, final_cdr);
+    if (!sm_is_ok(err)) {
         if (dot_root != &dot)
             sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
-        snprintf(err_buf, sizeof(err_buf), "%.*s: expected %zu arguments, %zu given",
-            (int) pattern->name.length, pattern->name.data,
-            pattern->count, available);
-        return sm_error(ctx, SmErrorExcessArguments, err_buf);
-    } else if (!pattern->rest.use && (!sm_value_is_nil(final_cdr) || sm_value_is_quoted(final_cdr))) {
-        if (dot_root != &dot)
-            sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
-
-        snprintf(err_buf, sizeof(err_buf), "%.*s: cannot accept dotted argument list",
-            (int) pattern->name.length, pattern->name.data);
-        return sm_error(ctx, SmErrorInvalidArgument, err_buf);
+        return err;
     }
 
     // At this point we know input matches the pattern so we can get away
@@ -243,20 +436,27 @@ SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmSco
         } else if (!pattern->rest.eval) {
             // If no evaluation is needed, we can just return args
             sm_scope_set(scope, pattern->rest.id, args);
+            sm_heap_write_barrier(&ctx->heap, scope);
             return sm_ok;
         } else if (!arg) {
             // If evaluation is needed but we only have the dot part,
             // we can just return the evaluated dot part
             sm_scope_set(scope, pattern->rest.id, *dot_root);
+            sm_heap_write_barrier(&ctx->heap, scope);
             if (dot_root != &dot)
                 sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
             return sm_ok;
         }
     }
 
-    SmError err = sm_ok;
     bool into_dot = false;
 
+    // Evaluate into a root: scope and rest list may be promoted while evaluating
+    SmValue value_root;
+    SmHeapRootFrame roots;
+    sm_heap_root_frame_push(&ctx->heap, &roots, &value_root, 1);
+    SmValue* value = &value_root;
+
     if (!arg && sm_value_is_cons(*dot_root) && !sm_value_is_quoted(*dot_root)) {
         arg = dot_root->data.cons;
         into_dot = true;
@@ -266,14 +466,18 @@ SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmSco
     // at least pattern->count items
     for (size_t i = 0; i < pattern->count; ++i) {
         if (!into_dot && pattern->args[i].eval) {
-            SmVariable* var = sm_scope_set(scope, pattern->args[i].id, sm_value_nil());
-            err = sm_eval(ctx, arg->car, &var->value);
+            *value = sm_value_nil();
+            err = sm_eval(ctx, arg->car, value);
             if (!sm_is_ok(err))
                 break;
+
+            sm_scope_set(scope, pattern->args[i].id, *value);
         } else {
             sm_scope_set(scope, pattern->args[i].id, arg->car);
         }
 
+        sm_heap_write_barrier(&ctx->heap, scope);
+
         if (!(arg = sm_list_next(arg)) && !into_dot &&
                 sm_value_is_cons(*dot_root) && !sm_value_is_quoted(*dot_root))
         {
@@ -286,21 +490,28 @@ SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmSco
     if (sm_is_ok(err) && pattern->rest.use) {
         // Rest argument takes the value of the dot part...
         SmVariable* var = sm_scope_set(scope, pattern->rest.id, final_cdr);
+        sm_heap_write_barrier(&ctx->heap, scope);
 
         // ...unless there are more args to take, in which case we build a list
         if (arg) {
             var->value = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+            sm_heap_write_barrier(&ctx->heap, scope);
             SmCons* rest = var->value.data.cons;
 
             while (arg) {
                 if (!into_dot && pattern->rest.eval) {
-                    err = sm_eval(ctx, arg->car, &rest->car);
+                    *value = sm_value_nil();
+                    err = sm_eval(ctx, arg->car, value);
                     if (!sm_is_ok(err))
                         break;
+
+                    rest->car = *value;
                 } else {
                     rest->car = arg->car;
                 }
 
+                sm_heap_write_barrier(&ctx->heap, rest);
+
                 if (!(arg = sm_list_next(arg)) && !into_dot &&
                         sm_value_is_cons(*dot_root) && !sm_value_is_quoted(*dot_root))
                 {
@@ -311,14 +522,18 @@ SmError sm_arg_pattern_unpack(SmArgPattern const* pattern, SmContext* ctx, SmSco
 
                 if (arg) {
                     rest->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+                    sm_heap_write_barrier(&ctx->heap, rest);
                     rest = rest->cdr.data.cons;
                 }
             }
 
             rest->cdr = final_cdr;
+            sm_heap_write_barrier(&ctx->heap, rest);
         }
     }
 
+    sm_heap_root_frame_pop(&ctx->heap, &roots);
+
     if (dot_root != &dot)
         sm_heap_root_value_drop(&ctx->heap, ctx, dot_root);
 
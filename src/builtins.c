@@ -52,6 +52,58 @@ SmError SM_BUILTIN_SYMBOL(gc)(SmContext* ctx, SmValue args, SmValue* ret) {
     return sm_ok;
 }
 
+SmError SM_BUILTIN_SYMBOL(gc_stats)(SmContext* ctx, SmValue args, SmValue* ret) {
+    if (!sm_value_is_nil(args) || sm_value_is_quoted(args))
+        return sm_error(ctx, SmErrorExcessArguments, "gc-stats requires exactly 0 arguments");
+
+    SmGCStats const* stats = sm_heap_stats(&ctx->heap);
+    const SmGCPacing pacing = sm_heap_pacing(&ctx->heap);
+
+    struct { char const* key; uint64_t value; } const entries[] = {
+        { ":collections", stats->collections },
+        { ":minor-collections", stats->minor_collections },
+        { ":pause-total-ns", stats->pause_total_ns },
+        { ":pause-max-ns", stats->pause_max_ns },
+        { ":pause-p50-ns", sm_gc_stats_pause_percentile(stats, 0.5) },
+        { ":pause-p99-ns", sm_gc_stats_pause_percentile(stats, 0.99) },
+        { ":symbols-allocated", stats->allocated_objects[SmHeapObjectSymbol] },
+        { ":symbol-bytes-allocated", stats->allocated_bytes[SmHeapObjectSymbol] },
+        { ":conses-allocated", stats->allocated_objects[SmHeapObjectCons] },
+        { ":cons-bytes-allocated", stats->allocated_bytes[SmHeapObjectCons] },
+        { ":scopes-allocated", stats->allocated_objects[SmHeapObjectScope] },
+        { ":scope-bytes-allocated", stats->allocated_bytes[SmHeapObjectScope] },
+        { ":functions-allocated", stats->allocated_objects[SmHeapObjectFunction] },
+        { ":function-bytes-allocated", stats->allocated_bytes[SmHeapObjectFunction] },
+        { ":strings-allocated", stats->allocated_objects[SmHeapObjectString] },
+        { ":string-bytes-allocated", stats->allocated_bytes[SmHeapObjectString] },
+        { ":objects-freed", stats->freed_objects },
+        { ":bytes-freed", stats->freed_bytes },
+        { ":objects-marked", stats->marked_objects },
+        { ":edges-marked", stats->marked_edges },
+        { ":roots-scanned", stats->roots_scanned },
+        { ":heap-bytes", pacing.heap_bytes },
+        { ":live-bytes", pacing.live_bytes },
+        { ":threshold", pacing.threshold }
+    };
+
+    // Build the plist backwards, ret is rooted by the caller
+    *ret = sm_value_nil();
+
+    for (size_t i = sizeof(entries)/sizeof(entries[0]); i > 0; --i) {
+        SmCons* value = sm_heap_alloc_cons(&ctx->heap, ctx);
+        value->car = sm_value_number(sm_number_int((int64_t) entries[i - 1].value));
+        value->cdr = *ret;
+        *ret = sm_value_cons(value);
+
+        SmCons* key = sm_heap_alloc_cons(&ctx->heap, ctx);
+        key->car = sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(entries[i - 1].key)));
+        key->cdr = *ret;
+        *ret = sm_value_cons(key);
+    }
+
+    return sm_ok;
+}
+
 SmError SM_BUILTIN_SYMBOL(eval)(SmContext* ctx, SmValue args, SmValue* ret) {
     if (!sm_value_is_list(args) || sm_value_is_quoted(args))
         return sm_error(ctx, SmErrorInvalidArgument, "eval cannot accept a dotted argument list");
@@ -103,7 +155,8 @@ SmError SM_BUILTIN_SYMBOL(gensym)(SmContext* ctx, SmValue args, SmValue* ret) {
     char* buf = sm_heap_alloc_string(&ctx->heap, ctx, length + 1);
     snprintf(buf, length + 1, "<gensym:%p>", (void*) ret->data.symbol);
 
-    *((SmString*) ret->data.symbol) = (SmString){ buf, length };
+    *((SmSymbolHeader*) ret->data.symbol) = sm_symbol_header((SmString){ buf, length });
+    sm_heap_write_barrier(&ctx->heap, ret->data.symbol);
 
     return sm_ok;
 }
@@ -114,7 +167,7 @@ SmError SM_BUILTIN_SYMBOL(set)(SmContext* ctx, SmValue args, SmValue* ret) {
     static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
     static const SmArgPattern pattern = {
         { "set", 3 },
-        pargs, 2, { NULL, false, false }
+        pargs, 2, { NULL, false, false }, SmArgPlanFixed
     };
 
     SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
@@ -124,16 +177,18 @@ SmError SM_BUILTIN_SYMBOL(set)(SmContext* ctx, SmValue args, SmValue* ret) {
     if (!sm_value_is_symbol(ret->data.cons->car) || sm_value_is_quoted(ret->data.cons->car))
         return_nil(sm_error(ctx, SmErrorInvalidArgument, "first argument to set must evaluate to an unquoted symbol"));
 
-    SmString str = sm_symbol_str(ret->data.cons->car.data.symbol);
-    if (str.length && str.data[0] == ':')
+    const SmSymbolKind kind = sm_symbol_kind(ret->data.cons->car.data.symbol);
+    if (kind == SmSymbolKeyword)
         return_nil(sm_error(ctx, SmErrorInvalidArgument, "keyword cannot be used as variable name"));
 
-    if (str.length == 3 && strncmp(str.data, "nil", 3) == 0)
+    if (kind == SmSymbolNil)
         return_nil(sm_error(ctx, SmErrorInvalidArgument, "nil constant cannot be used as variable name"));
 
-    SmVariable* var = sm_scope_lookup(ctx->scope, ret->data.cons->car.data.symbol);
+    SmScope* owner = NULL;
+    SmVariable* var = sm_scope_lookup_owner(ctx->scope, ret->data.cons->car.data.symbol, &owner);
     if (var) {
         var->value = ret->data.cons->cdr.data.cons->car;
+        sm_heap_write_barrier(&ctx->heap, owner);
     } else {
         sm_scope_set(&ctx->globals,
             ret->data.cons->car.data.symbol,
@@ -157,22 +212,25 @@ SmError SM_BUILTIN_SYMBOL(setq)(SmContext* ctx, SmValue args, SmValue* ret) {
         else if (!sm_value_is_symbol(cons->car) || sm_value_is_quoted(cons->car))
             return sm_error(ctx, SmErrorInvalidArgument, "odd arguments to setq must be unquoted symbols");
 
-        SmString str = sm_symbol_str(cons->car.data.symbol);
-        if (str.length && str.data[0] == ':')
+        const SmSymbolKind kind = sm_symbol_kind(cons->car.data.symbol);
+        if (kind == SmSymbolKeyword)
             return_nil(sm_error(ctx, SmErrorInvalidArgument, "keyword cannot be used as variable name"));
 
-        if (str.length == 3 && strncmp(str.data, "nil", 3) == 0)
+        if (kind == SmSymbolNil)
             return_nil(sm_error(ctx, SmErrorInvalidArgument, "nil constant cannot be used as variable name"));
 
         SmError err = sm_eval(ctx, cons->cdr.data.cons->car, ret);
         if (!sm_is_ok(err))
             return_nil(err);
 
-        SmVariable* var = sm_scope_lookup(ctx->scope, cons->car.data.symbol);
-        if (var)
+        SmScope* owner = NULL;
+        SmVariable* var = sm_scope_lookup_owner(ctx->scope, cons->car.data.symbol, &owner);
+        if (var) {
             var->value = *ret;
-        else
+            sm_heap_write_barrier(&ctx->heap, owner);
+        } else {
             sm_scope_set(&ctx->globals, cons->car.data.symbol, *ret);
+        }
 
         cons = sm_list_next(cons);
         if (!sm_value_is_list(cons->cdr) || sm_value_is_quoted(cons->cdr))
@@ -214,8 +272,6 @@ SmError SM_BUILTIN_SYMBOL(del)(SmContext* ctx, SmValue args, SmValue* ret) {
 
         *ret = var->value;
         sm_scope_delete(scope, cons->car.data.symbol);
-
-        sm_heap_unref(&ctx->heap, ctx, 1);
     }
 
     return sm_ok;
@@ -258,6 +314,10 @@ SmError SM_BUILTIN_SYMBOL(progn)(SmContext* ctx, SmValue args, SmValue* ret) {
     // Run each form in code list, return result of last one
     for (SmCons* code = args.data.cons; code; code = sm_list_next(code)) {
         *ret = sm_value_nil();
+
+        if (!sm_list_next(code))
+            return sm_eval_tail(ctx, code->car, ret);
+
         err = sm_eval(ctx, code->car, ret);
         if (!sm_is_ok(err))
             return_nil(err);
@@ -300,26 +360,32 @@ SmError SM_BUILTIN_SYMBOL(let)(SmContext* ctx, SmValue args, SmValue* ret) {
             break;
 
         SmSymbol id = sm_value_is_symbol(cons->car) ? cons->car.data.symbol : cons->car.data.cons->car.data.symbol;
-        SmString str = sm_symbol_str(id);
-        if (str.length && str.data[0] == ':') {
+        const SmSymbolKind kind = sm_symbol_kind(id);
+        if (kind == SmSymbolKeyword) {
             err = sm_error(ctx, SmErrorInvalidArgument, "keyword cannot be used as variable name");
             break;
         }
 
-        if (str.length == 3 && strncmp(str.data, "nil", 3) == 0) {
+        if (kind == SmSymbolNil) {
             err = sm_error(ctx, SmErrorInvalidArgument, "nil constant cannot be used as variable name");
             break;
         }
 
-        SmVariable* var = sm_scope_set(*scope, id, sm_value_nil());
+        // Evaluate into ret: the new scope may be promoted while evaluating
+        *ret = sm_value_nil();
 
         if (sm_value_is_cons(cons->car)) {
-            SmError err = sm_eval(ctx, cons->car.data.cons->cdr.data.cons->car, &var->value);
+            err = sm_eval(ctx, cons->car.data.cons->cdr.data.cons->car, ret);
             if (!sm_is_ok(err))
                 break;
         }
+
+        sm_scope_set(*scope, id, *ret);
+        sm_heap_write_barrier(&ctx->heap, *scope);
     }
 
+    sm_scope_seal(*scope);
+
     ctx->scope = *scope;
 
     // Return nil when code list is empty
@@ -377,13 +443,13 @@ SmError SM_BUILTIN_SYMBOL(let_serial)(SmContext* ctx, SmValue args, SmValue* ret
             break;
 
         SmSymbol id = sm_value_is_symbol(cons->car) ? cons->car.data.symbol : cons->car.data.cons->car.data.symbol;
-        SmString str = sm_symbol_str(id);
-        if (str.length && str.data[0] == ':') {
+        const SmSymbolKind kind = sm_symbol_kind(id);
+        if (kind == SmSymbolKeyword) {
             err = sm_error(ctx, SmErrorInvalidArgument, "keyword cannot be used as variable name");
             break;
         }
 
-        if (str.length == 3 && strncmp(str.data, "nil", 3) == 0) {
+        if (kind == SmSymbolNil) {
             err = sm_error(ctx, SmErrorInvalidArgument, "nil constant cannot be used as variable name");
             break;
         }
@@ -391,14 +457,17 @@ SmError SM_BUILTIN_SYMBOL(let_serial)(SmContext* ctx, SmValue args, SmValue* ret
         *ret = sm_value_nil();
 
         if (sm_value_is_cons(cons->car)) {
-            SmError err = sm_eval(ctx, cons->car.data.cons->cdr.data.cons->car, ret);
+            err = sm_eval(ctx, cons->car.data.cons->cdr.data.cons->car, ret);
             if (!sm_is_ok(err))
                 break;
         }
 
         sm_scope_set(*scope, id, *ret);
+        sm_heap_write_barrier(&ctx->heap, *scope);
     }
 
+    sm_scope_seal(*scope);
+
     // Return nil when code list is empty
     *ret = sm_value_nil();
 
@@ -432,9 +501,9 @@ SmError SM_BUILTIN_SYMBOL(if)(SmContext* ctx, SmValue args, SmValue* ret) {
         return_nil(err);
 
     if (!sm_value_is_nil(*ret)) {
-        return sm_eval(ctx, args.data.cons->cdr.data.cons->car, ret);
+        return sm_eval_tail(ctx, args.data.cons->cdr.data.cons->car, ret);
     } else if (argc == 3) {
-        return sm_eval(ctx, args.data.cons->cdr.data.cons->cdr.data.cons->car, ret);
+        return sm_eval_tail(ctx, args.data.cons->cdr.data.cons->cdr.data.cons->car, ret);
     }
 
     return_nil(sm_ok);
@@ -466,14 +535,18 @@ SmError SM_BUILTIN_SYMBOL(ignore_errors)(SmContext* ctx, SmValue args, SmValue*
             strncpy(&err_code[1], str.data, str.length);
             err_code[str.length + 1] = '\0';
 
-            char* err_msg = sm_heap_alloc_string(&ctx->heap, ctx, err.message.length);
-            strncpy(err_msg, err.message.data, err.message.length);
-
             sm_build_list(ctx, ret,
                 SmBuildCar, sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":error"))),
                 SmBuildCar, sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(err_code))),
-                SmBuildCar, sm_value_string((SmString){ err_msg, err.message.length }),
+                SmBuildCar, sm_value_nil(),
                 SmBuildEnd);
+
+            // Allocate message last: list is reachable from ret, the string would not be
+            SmStringHeader const* err_msg = sm_heap_alloc_string_value(&ctx->heap, ctx, err.message);
+
+            SmCons* msg = sm_list_next(sm_list_next(ret->data.cons));
+            msg->car = sm_value_string(err_msg);
+            sm_heap_write_barrier(&ctx->heap, msg);
             break;
         }
     }
@@ -487,7 +560,7 @@ SmError SM_BUILTIN_SYMBOL(cons)(SmContext* ctx, SmValue args, SmValue* ret) {
     static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
     static const SmArgPattern pattern = {
         { "cons", 4 },
-        pargs, 2, { NULL, false, false }
+        pargs, 2, { NULL, false, false }, SmArgPlanFixed
     };
 
     SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
@@ -496,6 +569,7 @@ SmError SM_BUILTIN_SYMBOL(cons)(SmContext* ctx, SmValue args, SmValue* ret) {
 
     // Second argument becomes cdr
     ret->data.cons->cdr = ret->data.cons->cdr.data.cons->car;
+    sm_heap_write_barrier(&ctx->heap, ret->data.cons);
 
     return sm_ok;
 }
@@ -504,7 +578,7 @@ SmError SM_BUILTIN_SYMBOL(list)(SmContext* ctx, SmValue args, SmValue* ret) {
     // Optional argument list, evaluated
     static const SmArgPattern pattern = {
         { "list", 4 },
-        NULL, 0, { NULL, true, true }
+        NULL, 0, { NULL, true, true }, SmArgPlanRest
     };
 
     SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
@@ -520,7 +594,7 @@ SmError SM_BUILTIN_SYMBOL(list_dot)(SmContext* ctx, SmValue args, SmValue* ret)
     static const SmArgPatternArg pargs[] = { { NULL, true } };
     static const SmArgPattern pattern = {
         { "list*", 5 },
-        pargs, 1, { NULL, true, true }
+        pargs, 1, { NULL, true, true }, SmArgPlanGeneral
     };
 
     SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
@@ -539,6 +613,7 @@ SmError SM_BUILTIN_SYMBOL(list_dot)(SmContext* ctx, SmValue args, SmValue* ret)
 
     // Use last argument as final cdr
     arg->cdr = arg->cdr.data.cons->car;
+    sm_heap_write_barrier(&ctx->heap, arg);
 
     // Return evaluated argument list
     return sm_ok;
@@ -620,9 +695,8 @@ SmError SM_BUILTIN_SYMBOL(copy)(SmContext* ctx, SmValue args, SmValue* ret) {
     SmError err = sm_eval(ctx, args.data.cons->car, ret);
     if (sm_is_ok(err)) {
         if (sm_value_is_string(*ret)) {
-            char* buf = sm_heap_alloc_string(&ctx->heap, ctx, ret->data.string.length);
-            strncpy(buf, ret->data.string.data, ret->data.string.length);
-            ret->data.string.data = buf;
+            const uint8_t quotes = ret->quotes;
+            *ret = sm_value_quote(sm_value_string(sm_heap_alloc_string_value(&ctx->heap, ctx, ret->data.string->str)), quotes);
         } else if (sm_value_is_cons(*ret)) {
             SmValue* copy = sm_heap_root_value(&ctx->heap);
             sm_list_copy(ctx, ret->data.cons, copy);
@@ -672,17 +746,23 @@ SmError SM_BUILTIN_SYMBOL(append)(SmContext* ctx, SmValue args, SmValue* ret) {
 
         sm_list_copy(ctx, slot->data.cons, tmp);
         *slot = *tmp;
+        sm_heap_write_barrier(&ctx->heap, slot);
 
         for (SmCons* cons = slot->data.cons; cons; cons = sm_list_next(cons))
             slot = &cons->cdr;
 
         *slot = sm_value_nil();
 
-        // Find first non-nil value
+        // Find first non-nil value, evaluate into tmp: the cons holding
+        // slot may be promoted while evaluating
         while (arg && sm_value_is_nil(*slot) && !sm_value_is_quoted(*slot)) {
-            err = sm_eval(ctx, arg->car, slot);
+            *tmp = sm_value_nil();
+            err = sm_eval(ctx, arg->car, tmp);
             if (!sm_is_ok(err))
                 break;
+
+            *slot = *tmp;
+            sm_heap_write_barrier(&ctx->heap, slot);
             arg = sm_list_next(arg);
         }
 
@@ -712,16 +792,17 @@ SmError SM_BUILTIN_SYMBOL(car)(SmContext* ctx, SmValue args, SmValue* ret) {
     if (!sm_is_ok(err))
         return_nil(err);
 
-    if (sm_value_is_quoted(*ret))
+    return sm_apply_car(ctx, *ret, ret);
+}
+
+SmError sm_apply_car(SmContext* ctx, SmValue list, SmValue* ret) {
+    if (sm_value_is_quoted(list))
         return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring("quote"))));
 
-    if (!sm_value_is_list(*ret))
+    if (!sm_value_is_list(list))
         return_nil(sm_error(ctx, SmErrorInvalidArgument, "car argument must be a list"));
 
-    if (!sm_value_is_nil(*ret))
-        *ret = ret->data.cons->car;
-
-    return sm_ok;
+    return_value(sm_value_is_nil(list) ? list : list.data.cons->car);
 }
 
 SmError SM_BUILTIN_SYMBOL(cdr)(SmContext* ctx, SmValue args, SmValue* ret) {
@@ -738,19 +819,21 @@ SmError SM_BUILTIN_SYMBOL(cdr)(SmContext* ctx, SmValue args, SmValue* ret) {
     if (!sm_is_ok(err))
         return_nil(err);
 
-    if (sm_value_is_quoted(*ret)) {
+    return sm_apply_cdr(ctx, *ret, ret);
+}
+
+SmError sm_apply_cdr(SmContext* ctx, SmValue list, SmValue* ret) {
+    // list must be reachable by the caller: allocation may collect
+    if (sm_value_is_quoted(list)) {
         SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
-        cons->car = sm_value_unquote(*ret, 1);
+        cons->car = sm_value_unquote(list, 1);
         return_value(sm_value_cons(cons));
     }
 
-    if (!sm_value_is_list(*ret))
+    if (!sm_value_is_list(list))
         return_nil(sm_error(ctx, SmErrorInvalidArgument, "cdr argument must be a list"));
 
-    if (!sm_value_is_nil(*ret))
-        *ret = ret->data.cons->cdr;
-
-    return sm_ok;
+    return_value(sm_value_is_nil(list) ? list : list.data.cons->cdr);
 }
 
 
@@ -775,7 +858,8 @@ SmError SM_BUILTIN_SYMBOL(caar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -804,7 +888,8 @@ SmError SM_BUILTIN_SYMBOL(cadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -833,7 +918,8 @@ SmError SM_BUILTIN_SYMBOL(cdar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -861,7 +947,8 @@ SmError SM_BUILTIN_SYMBOL(cddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -893,7 +980,8 @@ SmError SM_BUILTIN_SYMBOL(caaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -925,7 +1013,8 @@ SmError SM_BUILTIN_SYMBOL(caadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -957,7 +1046,8 @@ SmError SM_BUILTIN_SYMBOL(cadar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cadar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -989,7 +1079,8 @@ SmError SM_BUILTIN_SYMBOL(cdaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1021,7 +1112,8 @@ SmError SM_BUILTIN_SYMBOL(caddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1053,7 +1145,8 @@ SmError SM_BUILTIN_SYMBOL(cddar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cddar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1085,7 +1178,8 @@ SmError SM_BUILTIN_SYMBOL(cdadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1116,7 +1210,8 @@ SmError SM_BUILTIN_SYMBOL(cdddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1151,7 +1246,8 @@ SmError SM_BUILTIN_SYMBOL(caaaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caaaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1186,7 +1282,8 @@ SmError SM_BUILTIN_SYMBOL(caaadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caaadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1221,7 +1318,8 @@ SmError SM_BUILTIN_SYMBOL(caadar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caadar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1256,7 +1354,8 @@ SmError SM_BUILTIN_SYMBOL(cadaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cadaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1291,7 +1390,8 @@ SmError SM_BUILTIN_SYMBOL(cdaaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdaaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1326,7 +1426,8 @@ SmError SM_BUILTIN_SYMBOL(caaddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caaddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1361,7 +1462,8 @@ SmError SM_BUILTIN_SYMBOL(caddar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("caddar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1396,7 +1498,8 @@ SmError SM_BUILTIN_SYMBOL(cddaar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cddaar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1431,7 +1534,8 @@ SmError SM_BUILTIN_SYMBOL(cadadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cadadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1466,7 +1570,8 @@ SmError SM_BUILTIN_SYMBOL(cdadar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdadar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1501,7 +1606,8 @@ SmError SM_BUILTIN_SYMBOL(cdaadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdaadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1536,7 +1642,8 @@ SmError SM_BUILTIN_SYMBOL(cadddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cadddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1571,7 +1678,8 @@ SmError SM_BUILTIN_SYMBOL(cdaddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdaddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1606,7 +1714,8 @@ SmError SM_BUILTIN_SYMBOL(cddadr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cddadr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1641,7 +1750,8 @@ SmError SM_BUILTIN_SYMBOL(cdddar)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cdddar"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1675,7 +1785,8 @@ SmError SM_BUILTIN_SYMBOL(cddddr)(SmContext* ctx, SmValue* ret) {
         false,
         sm_arg_pattern_from_spec(sm_string_from_cstring("cddddr"), sm_value_cons(&args)),
         NULL,
-        ret->data.cons
+        ret->data.cons,
+        sm_bytecode(), 0
     };
     *ret = sm_value_function(fn);
 
@@ -1683,44 +1794,27 @@ SmError SM_BUILTIN_SYMBOL(cddddr)(SmContext* ctx, SmValue* ret) {
 }
 
 
-SmError SM_BUILTIN_SYMBOL(add)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Optional argument list, evaluated
-    static const SmArgPattern pattern = {
-        { "+", 1 },
-        NULL, 0, { NULL, true, true }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
+// Evaluate arguments into an array and apply an arithmetic operation
+static SmError arith(SmContext* ctx, SmArgPattern const* pattern, SmBuiltinArith op, SmValue args, SmValue* ret) {
+    SmArgValues values;
+    SmError err = sm_arg_pattern_eval_values(pattern, ctx, args, &values);
     if (!sm_is_ok(err))
         return_nil(err);
 
-    SmNumber res = sm_number_int(0);
-    SmCons* arg = (sm_value_is_cons(*ret) ? ret->data.cons : NULL);
-
-    // Sum integers
-    for (; arg; arg = sm_list_next(arg)) {
-        if (!sm_value_is_number(arg->car))
-            return_nil(sm_error(ctx, SmErrorInvalidArgument, "+ arguments must be numbers"));
-
-        if (!sm_number_is_int(arg->car.data.number))
-            break;
-
-        res.value.i += arg->car.data.number.value.i;
-    }
-
-    // Sum floats
-    if (arg) {
-        res = sm_number_as_float(res);
+    err = sm_apply_arith(ctx, op, values.values, values.count, ret);
+    sm_arg_values_drop(ctx, &values);
 
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "+ arguments must be numbers"));
+    return err;
+}
 
-            res.value.f += sm_number_as_float(arg->car.data.number).value.f;
-        }
-    }
+SmError SM_BUILTIN_SYMBOL(add)(SmContext* ctx, SmValue args, SmValue* ret) {
+    // Optional argument list, evaluated
+    static const SmArgPattern pattern = {
+        { "+", 1 },
+        NULL, 0, { NULL, true, true }, SmArgPlanRest
+    };
 
-    return_value(sm_value_number(res));
+    return arith(ctx, &pattern, SmBuiltinAdd, args, ret);
 }
 
 SmError SM_BUILTIN_SYMBOL(sub)(SmContext* ctx, SmValue args, SmValue* ret) {
@@ -1728,96 +1822,20 @@ SmError SM_BUILTIN_SYMBOL(sub)(SmContext* ctx, SmValue args, SmValue* ret) {
     static const SmArgPatternArg pargs[] = { { NULL, true } };
     static const SmArgPattern pattern = {
         { "-", 1 },
-        pargs, 1, { NULL, true, true }
+        pargs, 1, { NULL, true, true }, SmArgPlanGeneral
     };
 
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    // Argument list is not empty so skip type check
-    SmCons* arg = ret->data.cons;
-
-    if (!sm_value_is_number(arg->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "- arguments must be numbers"));
-
-    // If there is a single argument, invert sign
-    if (!sm_list_next(arg)) {
-        if (sm_number_is_int(arg->car.data.number))
-            return_value(sm_value_number(sm_number_int(- arg->car.data.number.value.i)));
-        else
-            return_value(sm_value_number(sm_number_float(- arg->car.data.number.value.f)));
-    }
-
-    SmNumber res = arg->car.data.number;
-    arg = sm_list_next(arg);
-
-    // Subtract integers
-    if (sm_number_is_int(res)) {
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "- arguments must be numbers"));
-
-            if (!sm_number_is_int(arg->car.data.number))
-                break;
-
-            res.value.i -= arg->car.data.number.value.i;
-        }
-    }
-
-    // Subtract floats
-    if (arg) {
-        res = sm_number_as_float(res);
-
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "- arguments must be numbers"));
-
-            res.value.f -= sm_number_as_float(arg->car.data.number).value.f;
-        }
-    }
-
-    return_value(sm_value_number(res));
+    return arith(ctx, &pattern, SmBuiltinSub, args, ret);
 }
 
 SmError SM_BUILTIN_SYMBOL(mul)(SmContext* ctx, SmValue args, SmValue* ret) {
     // Optional argument list, evaluated
     static const SmArgPattern pattern = {
         { "*", 1 },
-        NULL, 0, { NULL, true, true }
+        NULL, 0, { NULL, true, true }, SmArgPlanRest
     };
 
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    SmNumber res = sm_number_int(1);
-    SmCons* arg = (sm_value_is_cons(*ret) ? ret->data.cons : NULL);
-
-    // Multiply integers
-    for (; arg; arg = sm_list_next(arg)) {
-        if (!sm_value_is_number(arg->car))
-            return_nil(sm_error(ctx, SmErrorInvalidArgument, "* arguments must be numbers"));
-
-        if (!sm_number_is_int(arg->car.data.number))
-            break;
-
-        res.value.i *= arg->car.data.number.value.i;
-    }
-
-    // Multiply floats
-    if (arg) {
-        res = sm_number_as_float(res);
-
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "* arguments must be numbers"));
-
-            res.value.f *= sm_number_as_float(arg->car.data.number).value.f;
-        }
-    }
-
-    return_value(sm_value_number(res));
+    return arith(ctx, &pattern, SmBuiltinMul, args, ret);
 }
 
 SmError SM_BUILTIN_SYMBOL(div)(SmContext* ctx, SmValue args, SmValue* ret) {
@@ -1825,241 +1843,132 @@ SmError SM_BUILTIN_SYMBOL(div)(SmContext* ctx, SmValue args, SmValue* ret) {
     static const SmArgPatternArg pargs[] = { { NULL, true } };
     static const SmArgPattern pattern = {
         { "/", 1 },
-        pargs, 1, { NULL, true, true }
+        pargs, 1, { NULL, true, true }, SmArgPlanGeneral
     };
 
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
+    return arith(ctx, &pattern, SmBuiltinDiv, args, ret);
+}
 
-    // Argument list is not empty so skip type check
-    SmCons* arg = ret->data.cons;
+SmError sm_apply_arith(SmContext* ctx, SmBuiltinArith op, SmValue const* args, size_t count, SmValue* ret) {
+    static char const* const names[] = { "+", "-", "*", "/" };
 
-    if (!sm_value_is_number(arg->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "- arguments must be numbers"));
+    // + and * start from their identity, - and / from their first argument
+    SmNumber res = sm_number_int((op == SmBuiltinMul) ? 1 : 0);
+    size_t i = 0;
 
-    // If there is a single argument, return inverse
-    if (!sm_list_next(arg)) {
-        if (sm_number_is_int(arg->car.data.number))
-            return_value(sm_value_number(sm_number_int(1/arg->car.data.number.value.i)));
-        else
-            return_value(sm_value_number(sm_number_float(1.0/arg->car.data.number.value.f)));
-    }
+    if (op == SmBuiltinSub || op == SmBuiltinDiv) {
+        sm_assert(count > 0);
 
-    SmNumber res = arg->car.data.number;
-    arg = sm_list_next(arg);
+        if (!sm_value_is_number(args[0]))
+            goto not_a_number;
 
-    // Divide integers
-    if (sm_number_is_int(res)) {
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "/ arguments must be numbers"));
+        res = args[0].data.number;
+        i = 1;
 
-            if (!sm_number_is_int(arg->car.data.number))
-                break;
+        // If there is a single argument, invert sign or return inverse
+        if (count == 1) {
+            if (op == SmBuiltinSub)
+                res = sm_number_is_int(res) ? sm_number_int(-res.value.i) : sm_number_float(-res.value.f);
+            else
+                res = sm_number_is_int(res) ? sm_number_int(1/res.value.i) : sm_number_float(1.0/res.value.f);
 
-            res.value.i /= arg->car.data.number.value.i;
+            return_value(sm_value_number(res));
         }
     }
 
-    // Divide floats
-    if (arg) {
-        res = sm_number_as_float(res);
+    // Operate on integers until a float shows up, then on floats
+    for (; i < count; ++i) {
+        if (!sm_value_is_number(args[i]))
+            goto not_a_number;
 
-        for (; arg; arg = sm_list_next(arg)) {
-            if (!sm_value_is_number(arg->car))
-                return_nil(sm_error(ctx, SmErrorInvalidArgument, "/ arguments must be numbers"));
+        SmNumber arg = args[i].data.number;
 
-            res.value.f /= sm_number_as_float(arg->car.data.number).value.f;
+        if (sm_number_is_int(res) && sm_number_is_int(arg)) {
+            switch (op) {
+                case SmBuiltinAdd: res.value.i += arg.value.i; break;
+                case SmBuiltinSub: res.value.i -= arg.value.i; break;
+                case SmBuiltinMul: res.value.i *= arg.value.i; break;
+                case SmBuiltinDiv: res.value.i /= arg.value.i; break;
+            }
+        } else {
+            res = sm_number_as_float(res);
+
+            switch (op) {
+                case SmBuiltinAdd: res.value.f += sm_number_as_float(arg).value.f; break;
+                case SmBuiltinSub: res.value.f -= sm_number_as_float(arg).value.f; break;
+                case SmBuiltinMul: res.value.f *= sm_number_as_float(arg).value.f; break;
+                case SmBuiltinDiv: res.value.f /= sm_number_as_float(arg).value.f; break;
+            }
         }
     }
 
     return_value(sm_value_number(res));
-}
-
-
-SmError SM_BUILTIN_SYMBOL(eq)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { "=", 1 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "= arguments must be numbers"));
 
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i == rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f == rhs.value.f))
-    {
-        return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
+not_a_number:
+    snprintf(err_buf, sizeof(err_buf), "%s arguments must be numbers", names[op]);
+    return_nil(sm_error(ctx, SmErrorInvalidArgument, err_buf));
+}
+
+
+#define DEFINE_COMPARE_BUILTIN(id, name, op) \
+    SmError SM_BUILTIN_SYMBOL(id)(SmContext* ctx, SmValue args, SmValue* ret) { \
+        /* Two required arguments, evaluated */ \
+        static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } }; \
+        static const SmArgPattern pattern = { \
+            { name, sizeof(name) - 1 }, \
+            pargs, 2, { NULL, false, false }, SmArgPlanFixed \
+        }; \
+    \
+        SmArgValues values; \
+        SmError err = sm_arg_pattern_eval_values(&pattern, ctx, args, &values); \
+        if (!sm_is_ok(err)) \
+            return_nil(err); \
+    \
+        err = sm_apply_compare(ctx, op, values.values[0], values.values[1], ret); \
+        sm_arg_values_drop(ctx, &values); \
+    \
+        return err; \
     }
 
-    return_nil(sm_ok);
-}
+DEFINE_COMPARE_BUILTIN(eq,   "=",  SmBuiltinEq)
+DEFINE_COMPARE_BUILTIN(neq,  "!=", SmBuiltinNeq)
+DEFINE_COMPARE_BUILTIN(lt,   "<",  SmBuiltinLt)
+DEFINE_COMPARE_BUILTIN(lteq, "<=", SmBuiltinLteq)
+DEFINE_COMPARE_BUILTIN(gt,   ">",  SmBuiltinGt)
+DEFINE_COMPARE_BUILTIN(gteq, ">=", SmBuiltinGteq)
 
-SmError SM_BUILTIN_SYMBOL(neq)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { "!=", 2 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
+#undef DEFINE_COMPARE_BUILTIN
 
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "!= arguments must be numbers"));
+SmError sm_apply_compare(SmContext* ctx, SmBuiltinCompare op, SmValue lhs, SmValue rhs, SmValue* ret) {
+    static char const* const names[] = { "=", "!=", "<", "<=", ">", ">=" };
 
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i != rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f != rhs.value.f))
-    {
-        return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
+    if (!sm_value_is_number(lhs) || !sm_value_is_number(rhs)) {
+        snprintf(err_buf, sizeof(err_buf), "%s arguments must be numbers", names[op]);
+        return_nil(sm_error(ctx, SmErrorInvalidArgument, err_buf));
     }
 
-    return_nil(sm_ok);
-}
-
-SmError SM_BUILTIN_SYMBOL(lt)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { "<", 1 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "< arguments must be numbers"));
-
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i < rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f < rhs.value.f))
-    {
-        return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
+    SmNumberType t = sm_number_common_type(lhs.data.number.type, rhs.data.number.type);
+    SmNumber l = sm_number_as_type(t, lhs.data.number);
+    SmNumber r = sm_number_as_type(t, rhs.data.number);
+
+    int cmp = 0;
+    if (sm_number_is_int(l))
+        cmp = (l.value.i > r.value.i) - (l.value.i < r.value.i);
+    else if (l.value.f != r.value.f)
+        cmp = (l.value.f > r.value.f) ? 1 : (l.value.f < r.value.f) ? -1 : 2; // 2 when unordered
+
+    bool res = false;
+    switch (op) {
+        case SmBuiltinEq:   res = cmp == 0; break;
+        case SmBuiltinNeq:  res = cmp != 0; break;
+        case SmBuiltinLt:   res = cmp == -1; break;
+        case SmBuiltinLteq: res = cmp == -1 || cmp == 0; break;
+        case SmBuiltinGt:   res = cmp == 1; break;
+        case SmBuiltinGteq: res = cmp == 1 || cmp == 0; break;
     }
 
-    return_nil(sm_ok);
-}
-
-SmError SM_BUILTIN_SYMBOL(lteq)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { "<=", 2 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "<= arguments must be numbers"));
-
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i <= rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f <= rhs.value.f))
-    {
-        return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
-    }
-
-    return_nil(sm_ok);
-}
-
-SmError SM_BUILTIN_SYMBOL(gt)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { ">", 1 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, "> arguments must be numbers"));
-
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i > rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f > rhs.value.f))
-    {
+    if (res)
         return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
-    }
-
-    return_nil(sm_ok);
-}
-
-SmError SM_BUILTIN_SYMBOL(gteq)(SmContext* ctx, SmValue args, SmValue* ret) {
-    // Two required arguments, evaluated
-    static const SmArgPatternArg pargs[] = { { NULL, true }, { NULL, true } };
-    static const SmArgPattern pattern = {
-        { ">=", 2 },
-        pargs, 2, { NULL, false, false }
-    };
-
-    SmError err = sm_arg_pattern_eval(&pattern, ctx, args, ret);
-    if (!sm_is_ok(err))
-        return_nil(err);
-
-    if (!sm_value_is_number(ret->data.cons->car) || !sm_value_is_number(ret->data.cons->cdr.data.cons->car))
-        return_nil(sm_error(ctx, SmErrorInvalidArgument, ">= arguments must be numbers"));
-
-    SmNumber lhs = ret->data.cons->car.data.number;
-    SmNumber rhs = ret->data.cons->cdr.data.cons->car.data.number;
-
-    SmNumberType t = sm_number_common_type(lhs.type, rhs.type);
-    lhs = sm_number_as_type(t, lhs);
-    rhs = sm_number_as_type(t, rhs);
-
-    if ((sm_number_is_int(lhs) && lhs.value.i >= rhs.value.i) ||
-        (sm_number_is_float(lhs) && lhs.value.f >= rhs.value.f))
-    {
-        return_value(sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring(":true"))));
-    }
 
     return_nil(sm_ok);
 }
@@ -2100,6 +2009,10 @@ SmError SM_BUILTIN_SYMBOL(and)(SmContext* ctx, SmValue args, SmValue* ret) {
             return_nil(sm_error(ctx, SmErrorInvalidArgument, "and cannot accept a dotted code list"));
 
         *ret = sm_value_nil();
+
+        if (sm_value_is_nil(arg->cdr))
+            return sm_eval_tail(ctx, arg->car, ret);
+
         err = sm_eval(ctx, arg->car, ret);
         if (!sm_is_ok(err))
             return_nil(err);
@@ -2126,6 +2039,10 @@ SmError SM_BUILTIN_SYMBOL(or)(SmContext* ctx, SmValue args, SmValue* ret) {
             return_nil(sm_error(ctx, SmErrorInvalidArgument, "or cannot accept a dotted code list"));
 
         *ret = sm_value_nil();
+
+        if (sm_value_is_nil(arg->cdr))
+            return sm_eval_tail(ctx, arg->car, ret);
+
         err = sm_eval(ctx, arg->car, ret);
         if (!sm_is_ok(err))
             return_nil(err);
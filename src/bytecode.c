@@ -0,0 +1,452 @@
+#include "builtins.h"
+#include "bytecode.h"
+#include "context.h"
+#include "eval.h"
+
+#include <stdio.h>
+
+// Inlines
+extern inline SmBytecode sm_bytecode(void);
+extern inline bool sm_bytecode_is_compiled(SmBytecode const* code);
+extern inline void sm_bytecode_drop(SmBytecode* code);
+
+// Error message buffer
+static sm_thread_local char err_buf[1024];
+
+typedef enum Opcode {
+    OpConst,    // Push constants[arg]
+    OpVar,      // Push the value of symbol constants[arg], looked up from
+                // depth scopes above the current one
+    OpLocal,    // Push the value of symbol constants[arg] from slot count of
+                // the scope depth levels above the current one
+    OpEval,     // Push the result of evaluating constants[arg]
+    OpTailEval, // Stop, handing back constants[arg] to be evaluated by the
+                // caller in place of the call
+    OpGuard,    // Check that call constants[arg] still refers to builtin count:
+                // if so skip next instruction, otherwise push the result of
+                // evaluating the call and run it
+    OpJump,     // Continue at arg
+    OpJumpNil,  // Pop, continue at arg if nil
+    OpPop,      // Pop
+    OpArith,    // Pop count values, push the result of SmBuiltinArith arg
+    OpCompare,  // Pop 2 values, push the result of SmBuiltinCompare arg
+    OpCar,      // Replace top with its car
+    OpCdr,      // Replace top with its cdr
+    OpNot       // Replace top with constants[arg] (:true) if nil, nil otherwise
+} Opcode;
+
+// Builtins compiled to opcodes
+typedef enum Builtin {
+    BuiltinAdd,
+    BuiltinSub,
+    BuiltinMul,
+    BuiltinDiv,
+    BuiltinEq,
+    BuiltinNeq,
+    BuiltinLt,
+    BuiltinLteq,
+    BuiltinGt,
+    BuiltinGteq,
+    BuiltinCar,
+    BuiltinCdr,
+    BuiltinNot,
+    BuiltinIf,
+
+    BuiltinCount
+} Builtin;
+
+static const SmExternalFunction builtins[BuiltinCount] = {
+    SM_BUILTIN_SYMBOL(add),
+    SM_BUILTIN_SYMBOL(sub),
+    SM_BUILTIN_SYMBOL(mul),
+    SM_BUILTIN_SYMBOL(div),
+    SM_BUILTIN_SYMBOL(eq),
+    SM_BUILTIN_SYMBOL(neq),
+    SM_BUILTIN_SYMBOL(lt),
+    SM_BUILTIN_SYMBOL(lteq),
+    SM_BUILTIN_SYMBOL(gt),
+    SM_BUILTIN_SYMBOL(gteq),
+    SM_BUILTIN_SYMBOL(car),
+    SM_BUILTIN_SYMBOL(cdr),
+    SM_BUILTIN_SYMBOL(not),
+    SM_BUILTIN_SYMBOL(if)
+};
+
+typedef struct Compiler {
+    SmContext* ctx;
+    SmScope const* scope;
+    SmBytecode out;
+    size_t code_capacity;
+    size_t constant_capacity;
+    size_t depth;
+} Compiler;
+
+// Private helpers
+static void grow(void** data, size_t* capacity, size_t size, size_t element_size) {
+    if (size < *capacity)
+        return;
+
+    *capacity = *capacity ? 2*(*capacity) : 16;
+    *data = realloc(*data, *capacity*element_size);
+    sm_guard(*data != NULL, "allocation failed");
+}
+
+static size_t emit(Compiler* c, Opcode op, size_t count, size_t arg) {
+    sm_guard(c->out.size < UINT32_MAX, "lambda body too large");
+
+    grow((void**) &c->out.code, &c->code_capacity, c->out.size, sizeof(SmInstruction));
+    c->out.code[c->out.size] = (SmInstruction){ (uint8_t) op, 0, (uint16_t) count, (uint32_t) arg };
+    return c->out.size++;
+}
+
+static size_t constant(Compiler* c, SmValue value) {
+    sm_guard(c->out.constant_count < UINT32_MAX, "lambda body too large");
+
+    grow((void**) &c->out.constants, &c->constant_capacity, c->out.constant_count, sizeof(SmValue));
+    c->out.constants[c->out.constant_count] = value;
+    return c->out.constant_count++;
+}
+
+static void push(Compiler* c) {
+    if (++c->depth > c->out.stack_size)
+        c->out.stack_size = c->depth;
+}
+
+static void pop(Compiler* c, size_t count) {
+    c->depth -= count;
+}
+
+static void patch(Compiler* c, size_t jump) {
+    c->out.code[jump].arg = (uint32_t) c->out.size;
+}
+
+// Return the number of arguments in a proper list, or SIZE_MAX if the
+// list is dotted or quoted anywhere
+static size_t proper_list_size(SmValue list) {
+    size_t size = 0;
+
+    for (; sm_value_is_cons(list) && !sm_value_is_quoted(list); list = list.data.cons->cdr)
+        ++size;
+
+    return (sm_value_is_nil(list) && !sm_value_is_quoted(list)) ? size : SIZE_MAX;
+}
+
+static Builtin call_builtin(Compiler* c, SmCons* call, size_t argc) {
+    if (!sm_value_is_symbol(call->car) || sm_value_is_quoted(call->car) || argc > UINT16_MAX)
+        return BuiltinCount;
+
+    SmExternalFunction fn = sm_context_lookup_function(c->ctx, call->car.data.symbol);
+
+    Builtin builtin = BuiltinAdd;
+    while (builtin < BuiltinCount && builtins[builtin] != fn)
+        ++builtin;
+
+    // Calls with wrong arity are left to the builtin, which reports the error
+    switch (builtin) {
+        case BuiltinSub:
+        case BuiltinDiv:
+            return (argc >= 1) ? builtin : BuiltinCount;
+
+        case BuiltinEq:
+        case BuiltinNeq:
+        case BuiltinLt:
+        case BuiltinLteq:
+        case BuiltinGt:
+        case BuiltinGteq:
+            return (argc == 2) ? builtin : BuiltinCount;
+
+        case BuiltinCar:
+        case BuiltinCdr:
+        case BuiltinNot:
+            return (argc == 1) ? builtin : BuiltinCount;
+
+        case BuiltinIf:
+            return (argc == 2 || argc == 3) ? builtin : BuiltinCount;
+
+        default:
+            return builtin;
+    }
+}
+
+static void compile_variable(Compiler* c, SmValue form) {
+    SmScope const* scope = c->scope;
+    size_t depth = 0;
+    size_t ins = SIZE_MAX;
+
+    // Sealed scopes gain no new names, those lacking the variable can be
+    // skipped for good
+    for (; scope && scope->sealed && depth < UINT8_MAX; scope = scope->parent, ++depth) {
+        SmVariable const* var = sm_scope_get(scope, form.data.symbol);
+        if (!var)
+            continue;
+
+        const size_t index = (size_t) (var - sm_scope_slots(scope));
+        if (index <= UINT16_MAX)
+            ins = emit(c, OpLocal, index, constant(c, form));
+
+        break;
+    }
+
+    if (ins == SIZE_MAX)
+        ins = emit(c, OpVar, 0, constant(c, form));
+
+    c->out.code[ins].depth = (uint8_t) depth;
+}
+
+static void compile_form(Compiler* c, SmValue form, bool tail);
+
+static void compile_call(Compiler* c, SmValue form, bool tail) {
+    SmCons* call = form.data.cons;
+    const size_t argc = proper_list_size(call->cdr);
+    const Builtin builtin = (argc != SIZE_MAX) ? call_builtin(c, call, argc) : BuiltinCount;
+
+    if (builtin == BuiltinCount) {
+        emit(c, tail ? OpTailEval : OpEval, 0, constant(c, form));
+        push(c);
+        return;
+    }
+
+    // The call is evaluated as is if the builtin is replaced
+    emit(c, OpGuard, builtin, constant(c, form));
+    const size_t guard_jump = emit(c, OpJump, 0, 0);
+
+    SmCons* arg = sm_list_next(call);
+
+    if (builtin == BuiltinIf) {
+        compile_form(c, arg->car, false);
+        const size_t else_jump = emit(c, OpJumpNil, 0, 0);
+        pop(c, 1);
+
+        compile_form(c, (arg = sm_list_next(arg))->car, tail);
+        const size_t end_jump = emit(c, OpJump, 0, 0);
+        pop(c, 1);
+
+        patch(c, else_jump);
+        if ((arg = sm_list_next(arg))) {
+            compile_form(c, arg->car, tail);
+        } else {
+            emit(c, OpConst, 0, constant(c, sm_value_nil()));
+            push(c);
+        }
+
+        patch(c, end_jump);
+        patch(c, guard_jump);
+        return;
+    }
+
+    for (; arg; arg = sm_list_next(arg))
+        compile_form(c, arg->car, false);
+
+    switch (builtin) {
+        case BuiltinAdd:
+        case BuiltinSub:
+        case BuiltinMul:
+        case BuiltinDiv:
+            emit(c, OpArith, argc, (size_t) (SmBuiltinAdd + (builtin - BuiltinAdd)));
+            break;
+
+        case BuiltinEq:
+        case BuiltinNeq:
+        case BuiltinLt:
+        case BuiltinLteq:
+        case BuiltinGt:
+        case BuiltinGteq:
+            emit(c, OpCompare, 2, (size_t) (SmBuiltinEq + (builtin - BuiltinEq)));
+            break;
+
+        case BuiltinCar:
+            emit(c, OpCar, 1, 0);
+            break;
+
+        case BuiltinCdr:
+            emit(c, OpCdr, 1, 0);
+            break;
+
+        default: // Intern :true once, not on every run
+            emit(c, OpNot, 1, constant(c, sm_value_symbol(sm_symbol(&c->ctx->symbols, sm_string_from_cstring(":true")))));
+            break;
+    }
+
+    pop(c, argc);
+    push(c);
+
+    patch(c, guard_jump);
+}
+
+// Calls in tail position are handed back to the caller of the body
+static void compile_form(Compiler* c, SmValue form, bool tail) {
+    if (sm_value_is_quoted(form)) {
+        emit(c, OpConst, 0, constant(c, sm_value_unquote(form, 1)));
+    } else if (sm_value_is_symbol(form)) {
+        // nil and keywords cannot be rebound, other symbols may become
+        // externals and are checked when run
+        if (sm_symbol_kind(form.data.symbol) == SmSymbolNil)
+            emit(c, OpConst, 0, constant(c, sm_value_nil()));
+        else if (sm_symbol_kind(form.data.symbol) == SmSymbolKeyword)
+            emit(c, OpConst, 0, constant(c, form));
+        else
+            compile_variable(c, form);
+    } else if (sm_value_is_cons(form)) {
+        compile_call(c, form, tail);
+        return;
+    } else {
+        emit(c, OpConst, 0, constant(c, form));
+    }
+
+    push(c);
+}
+
+// Push the value of a variable the slow way, starting from scope
+static SmError load(SmContext* ctx, SmScope const* scope, SmValue symbol, SmValue* ret) {
+    SmSymbol id = symbol.data.symbol;
+
+    if (sm_symbol_kind(id) != SmSymbolPlain) {
+        *ret = sm_value_nil();
+        return sm_eval(ctx, symbol, ret);
+    }
+
+    SmVariable* var = sm_scope_lookup(scope, id);
+    if (!var) {
+        *ret = sm_value_nil();
+        SmString name = sm_symbol_str(id);
+        snprintf(err_buf, sizeof(err_buf), "variable not found: %.*s", (int) name.length, name.data);
+        return sm_error(ctx, SmErrorUndefinedVariable, err_buf);
+    }
+
+    *ret = var->value;
+    return sm_ok;
+}
+
+// Bytecode functions
+SmBytecode sm_bytecode_compile(SmContext* ctx, SmScope const* scope, SmCons* progn) {
+    Compiler c = { ctx, scope, sm_bytecode(), 0, 0, 0 };
+
+    // Return nil when code list is empty
+    if (!progn) {
+        emit(&c, OpConst, 0, constant(&c, sm_value_nil()));
+        push(&c);
+    }
+
+    // Keep the result of the last form only
+    for (SmCons* form = progn; form; form = sm_list_next(form)) {
+        compile_form(&c, form->car, !sm_list_next(form));
+
+        if (sm_list_next(form)) {
+            emit(&c, OpPop, 1, 0);
+            pop(&c, 1);
+        }
+    }
+
+    return c.out;
+}
+
+SmError sm_bytecode_run(SmBytecode const* code, SmContext* ctx, SmValue* ret) {
+    SmValue stack[code->stack_size];
+    SmHeapRootFrame roots;
+    sm_heap_root_frame_push(&ctx->heap, &roots, stack, code->stack_size);
+
+    SmValue const* constants = code->constants;
+    SmValue* sp = stack;
+    SmError err = sm_ok;
+
+    for (size_t pc = 0; pc < code->size && sm_is_ok(err);) {
+        const SmInstruction ins = code->code[pc++];
+
+        switch ((Opcode) ins.op) {
+            case OpConst:
+                *sp++ = constants[ins.arg];
+                break;
+
+            case OpVar: {
+                SmScope const* scope = ctx->scope;
+                for (uint8_t depth = ins.depth; depth; --depth)
+                    scope = scope->parent;
+
+                err = load(ctx, scope, constants[ins.arg], sp++);
+                break;
+            }
+
+            case OpLocal: {
+                SmScope const* scope = ctx->scope;
+                for (uint8_t depth = ins.depth; depth; --depth)
+                    scope = scope->parent;
+
+                SmVariable const* var = sm_scope_slot(scope, ins.count);
+                if (var->id && sm_symbol_kind(var->id) == SmSymbolPlain) {
+                    *sp++ = var->value;
+                    break;
+                }
+
+                // Deleted, or shadowed by an external registered since
+                err = load(ctx, ctx->scope, constants[ins.arg], sp++);
+                break;
+            }
+
+            case OpEval:
+                *sp = sm_value_nil();
+                err = sm_eval(ctx, constants[ins.arg], sp++);
+                break;
+
+            case OpTailEval:
+                *sp++ = constants[ins.arg];
+                ctx->tail = true;
+                pc = code->size;
+                break;
+
+            case OpGuard: {
+                SmCons const* call = constants[ins.arg].data.cons;
+
+                if (sm_context_lookup_function(ctx, call->car.data.symbol) == builtins[ins.count]) {
+                    ++pc; // Skip fallback jump
+                } else {
+                    *sp = sm_value_nil();
+                    err = sm_eval(ctx, constants[ins.arg], sp++);
+                }
+                break;
+            }
+
+            case OpJump:
+                pc = ins.arg;
+                break;
+
+            case OpJumpNil:
+                if (sm_value_is_nil(*--sp))
+                    pc = ins.arg;
+                break;
+
+            case OpPop:
+                --sp;
+                break;
+
+            case OpArith:
+                sp -= ins.count;
+                err = sm_apply_arith(ctx, (SmBuiltinArith) ins.arg, sp, ins.count, sp);
+                ++sp;
+                break;
+
+            case OpCompare:
+                sp -= 2;
+                err = sm_apply_compare(ctx, (SmBuiltinCompare) ins.arg, sp[0], sp[1], sp);
+                ++sp;
+                break;
+
+            case OpCar:
+                err = sm_apply_car(ctx, sp[-1], &sp[-1]);
+                break;
+
+            case OpCdr:
+                err = sm_apply_cdr(ctx, sp[-1], &sp[-1]);
+                break;
+
+            case OpNot:
+                sp[-1] = sm_value_is_nil(sp[-1]) ? constants[ins.arg] : sm_value_nil();
+                break;
+        }
+    }
+
+    *ret = sm_is_ok(err) ? sp[-1] : sm_value_nil();
+
+    sm_heap_root_frame_pop(&ctx->heap, &roots);
+
+    return err;
+}
@@ -0,0 +1,189 @@
+#include "builtins.h"
+#include "context.h"
+#include "eval.h"
+#include "function.h"
+#include "parser.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct Result {
+    SmError err;
+    SmValue* value;
+} Result;
+
+// Evaluate every form in source, keep the result of the last one
+static Result run(SmContext* ctx, char const* source) {
+    SmValue* forms = sm_heap_root_value(&ctx->heap);
+    Result res = { sm_ok, sm_heap_root_value(&ctx->heap) };
+
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+    res.err = sm_parser_parse_all(&parser, ctx, forms);
+
+    for (SmCons* form = forms->data.cons; sm_is_ok(res.err) && form; form = sm_list_next(form)) {
+        *res.value = sm_value_nil();
+        res.err = sm_eval(ctx, form->car, res.value);
+    }
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, forms);
+    return res;
+}
+
+static bool values_equal(SmValue lhs, SmValue rhs) {
+    if (lhs.type != rhs.type || lhs.quotes != rhs.quotes)
+        return false;
+
+    switch (lhs.type) {
+        case SmTypeNil:
+            return true;
+        case SmTypeNumber:
+            return lhs.data.number.type == rhs.data.number.type &&
+                (sm_number_is_int(lhs.data.number) ?
+                    lhs.data.number.value.i == rhs.data.number.value.i :
+                    lhs.data.number.value.f == rhs.data.number.value.f);
+        case SmTypeSymbol:
+        case SmTypeExternal:
+            return lhs.data.symbol == rhs.data.symbol ||
+                (sm_symbol_str(lhs.data.symbol).length == sm_symbol_str(rhs.data.symbol).length &&
+                 memcmp(sm_symbol_str(lhs.data.symbol).data, sm_symbol_str(rhs.data.symbol).data,
+                        sm_symbol_str(lhs.data.symbol).length) == 0);
+        case SmTypeString:
+            return lhs.data.string->str.length == rhs.data.string->str.length &&
+                memcmp(lhs.data.string->str.data, rhs.data.string->str.data, lhs.data.string->str.length) == 0;
+        case SmTypeCons:
+            return values_equal(lhs.data.cons->car, rhs.data.cons->car) &&
+                values_equal(lhs.data.cons->cdr, rhs.data.cons->cdr);
+        default:
+            return lhs.data.function == rhs.data.function;
+    }
+}
+
+// Run source with and without bytecode, expect identical outcomes
+static bool same_as_tree_walker(char const* source) {
+    SmContext* compiled = sm_context((SmGCConfig){ 4096, 1.5, 1024 });
+    SmContext* walked = sm_context((SmGCConfig){ 4096, 1.5, 1024 });
+    sm_register_builtins(compiled);
+    sm_register_builtins(walked);
+    walked->bytecode = false;
+    compiled->compile_calls = 0;
+
+    Result lhs = run(compiled, source);
+    Result rhs = run(walked, source);
+
+    const bool same = lhs.err.code == rhs.err.code &&
+        lhs.err.message.length == rhs.err.message.length &&
+        memcmp(lhs.err.message.data, rhs.err.message.data, lhs.err.message.length) == 0 &&
+        values_equal(*lhs.value, *rhs.value);
+
+    sm_heap_root_value_drop(&compiled->heap, compiled, lhs.value);
+    sm_heap_root_value_drop(&walked->heap, walked, rhs.value);
+    sm_context_drop(compiled);
+    sm_context_drop(walked);
+
+    return same;
+}
+
+static SmError forty_two(SmContext* ctx, SmValue args, SmValue* ret) {
+    sm_unused(ctx);
+    sm_unused(args);
+    *ret = sm_value_number(sm_number_int(42));
+    return sm_ok;
+}
+
+int main(int argc, char* argv[]) {
+    SmTestContext ctx = sm_test_context(argc, argv);
+
+    sm_test(&ctx, "compiled arithmetic should match the tree walker",
+        same_as_tree_walker(
+            "((lambda (a b) (list (+) (+ a b 1.5) (* a b) (- a) (- a b 1) (/ b) (/ 7.0 b) (* 2 2.5))) 3 4)"));
+
+    sm_test(&ctx, "compiled comparisons and conditionals should match the tree walker",
+        same_as_tree_walker(
+            "((lambda (a b) (list (= a b) (!= a b) (< a b) (<= a 3.0) (> a b) (>= b a)"
+            "                     (if (< a b) 'less 'more) (if nil 1) (not a) (not nil))) 3 4)"));
+
+    sm_test(&ctx, "compiled car and cdr should match the tree walker",
+        same_as_tree_walker(
+            "((lambda (x) (list (car x) (cdr x) (car nil) (cdr nil) (car ''y) (cdr ''z))) '(1 2))"));
+
+    sm_test(&ctx, "compiled recursion should match the tree walker",
+        same_as_tree_walker(
+            "(set 'fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+            "(fib 15)"));
+
+    sm_test(&ctx, "forms left to the tree walker should run in the compiled body",
+        same_as_tree_walker(
+            "((lambda (n) (setq n (+ n 1)) (let ((m (* n 2)) (extra (quote (1 2)))) (+ n m . extra))) 5)"));
+
+    sm_test(&ctx, "errors in compiled code should match the tree walker",
+        same_as_tree_walker("((lambda (x) (+ x 'a)) 1)") &&
+        same_as_tree_walker("((lambda (x) (< x \"a\")) 1)") &&
+        same_as_tree_walker("((lambda (x) (car x)) 5)") &&
+        same_as_tree_walker("((lambda (x) (- x) (/ x) y) 5)") &&
+        same_as_tree_walker("((lambda (x) (if x)) 5)"));
+
+    sm_test(&ctx, "empty lambda bodies should return nil",
+        same_as_tree_walker("((lambda ()))"));
+
+    sm_test(&ctx, "variables resolved to slots should match the tree walker",
+        same_as_tree_walker(
+            "(set 'adder (lambda (n) (lambda (x) (+ x n))))"
+            "(set 'add2 (adder 2))"
+            "(list (add2 1) (add2 5) ((lambda (x x) x) 1 2) ((lambda (a . rest) (list rest a)) 1 2 3))") &&
+        same_as_tree_walker(
+            "(set 'f (let ((a 1) (b 2)) (lambda (c) (setq b (+ b c)) (list a b c))))"
+            "(f 1) (f 10)"));
+
+    sm_test(&ctx, "scopes outgrowing their inline slots should keep every variable",
+        same_as_tree_walker(
+            "((lambda (a b c d e f . g) (let ((h 8) (i 9) (j 10) (k 11) (l 12))"
+            "                             (list a b c d e f g h i j k l))) 1 2 3 4 5 6 7)") &&
+        same_as_tree_walker(
+            "(set 'f ((lambda (a b c d e) (lambda () (list e d c b a))) 1 2 3 4 5)) (f)"));
+
+    sm_test(&ctx, "deleted slots should fall back to outer variables",
+        same_as_tree_walker("(set 'x 'global) ((lambda (x) (list x (del x) x)) 'local)") &&
+        same_as_tree_walker("((lambda (x) (del x) x) 'local)"));
+
+    sm_test(&ctx, "scopes still being bound should not be resolved to slots",
+        same_as_tree_walker(
+            "(set 'y 'global)"
+            "(let* ((f (lambda () y)) (early (f)) (y 'local)) (list early (f)))"));
+
+    // Lambdas run in the tree walker until called compile_calls times
+    SmContext* counted = sm_context((SmGCConfig){ 1 << 20, 2.0, 0 });
+    sm_register_builtins(counted);
+    counted->compile_calls = 2;
+
+    Result before = run(counted, "(set 'f (lambda (x) (+ x 1))) (f 1) (f 2) f");
+    const bool walked = sm_is_ok(before.err) && !sm_bytecode_is_compiled(&before.value->data.function->code);
+    Result after = run(counted, "(f 3) f");
+
+    sm_test(&ctx, "lambdas should be compiled after compile_calls calls",
+        walked && sm_is_ok(after.err) && sm_bytecode_is_compiled(&after.value->data.function->code));
+
+    sm_heap_root_value_drop(&counted->heap, counted, after.value);
+    sm_heap_root_value_drop(&counted->heap, counted, before.value);
+    sm_context_drop(counted);
+
+    // Builtins replaced after compilation must be honored
+    SmContext* lisp = sm_context((SmGCConfig){ 1 << 20, 2.0, 0 });
+    sm_register_builtins(lisp);
+    lisp->compile_calls = 0;
+
+    Result first = run(lisp, "(set 'f (lambda (x) (+ x 1))) (f 1)");
+    sm_context_register_function(lisp, sm_symbol(&lisp->symbols, sm_string_from_cstring("+")), forty_two);
+    Result second = run(lisp, "(f 1)");
+
+    sm_test(&ctx, "compiled calls should follow builtins replaced after compilation",
+        sm_is_ok(first.err) && first.value->data.number.value.i == 2 &&
+        sm_is_ok(second.err) && second.value->data.number.value.i == 42);
+
+    sm_heap_root_value_drop(&lisp->heap, lisp, second.value);
+    sm_heap_root_value_drop(&lisp->heap, lisp, first.value);
+    sm_context_drop(lisp);
+
+    return !sm_test_report(&ctx);
+}
@@ -1,24 +1,63 @@
 #include "context.h"
-#include "private/context.h"
 
 // Inlines
 extern inline void sm_context_enter_frame(SmContext* ctx, SmStackFrame* frame, SmString name);
 extern inline void sm_context_exit_frame(SmContext* ctx);
+extern inline SmExternalFunction sm_context_lookup_function(SmContext* ctx, SmSymbol id);
+extern inline SmExternalVariable sm_context_lookup_variable(SmContext* ctx, SmSymbol id);
+
+#define INITIAL_EXTERNALS 64
+
+// Private helpers
+static SmExternal* external_slot(SmContext* ctx, SmSymbol id) {
+    // nil and keywords cannot be rebound
+    sm_guard(sm_symbol_kind(id) != SmSymbolNil && sm_symbol_kind(id) != SmSymbolKeyword,
+        "cannot register nil or a keyword as an external");
+
+    SmExternalTable* table = &ctx->externals;
+
+    if (!sm_symbol_slot(id)) {
+        if (table->size == table->capacity) {
+            const size_t capacity = table->capacity ? 2*table->capacity : INITIAL_EXTERNALS;
+            SmExternal* slots = realloc(table->slots, capacity*sizeof(SmExternal));
+            sm_guard(slots != NULL, "allocation failed");
+
+            table->slots = slots;
+            table->capacity = capacity;
+        }
+
+        // Slot 0 is reserved for symbols without externals
+        if (!table->size)
+            table->slots[table->size++] = (SmExternal){ NULL };
+
+        sm_symbol_set_slot(id, (uint32_t) table->size++);
+    }
+
+    sm_assert(sm_symbol_slot(id) < table->size);
+    return &table->slots[sm_symbol_slot(id)];
+}
 
 SmContext* sm_context(SmGCConfig gc) {
     SmContext* ctx = sm_aligned_alloc(sm_alignof(SmContext), sizeof(SmContext));
 
     *ctx = (SmContext){
         sm_symbol_set(),
-        sm_rbtree(sizeof(External), sm_alignof(External), sm_symbol_key, sm_key_compare_ptr),
+        { NULL, 0, 0 },
 
         (SmStackFrame){ NULL, sm_string_from_cstring("<main>"), &ctx->globals },
-        sm_scope(NULL),
+        sm_scope_dynamic(NULL),
 
         &ctx->main,
         &ctx->globals,
 
-        sm_heap(gc)
+        sm_heap(gc),
+
+        true, SM_CONTEXT_COMPILE_CALLS,
+
+        0, SIZE_MAX,
+        0, SM_CONTEXT_MAX_DEPTH,
+        sm_stack_size()/8*7, 0,
+        false
     };
 
     return ctx;
@@ -26,7 +65,7 @@ SmContext* sm_context(SmGCConfig gc) {
 
 void sm_context_drop(SmContext* ctx) {
     sm_symbol_set_drop(&ctx->symbols);
-    sm_rbtree_drop(&ctx->externals);
+    free(ctx->externals.slots);
     sm_scope_drop(&ctx->globals);
     sm_heap_drop(&ctx->heap);
     free(ctx);
@@ -34,25 +73,19 @@ void sm_context_drop(SmContext* ctx) {
 
 // External function/variable management
 void sm_context_register_function(SmContext* ctx, SmSymbol id, SmExternalFunction fn) {
-    External b = { id, Function, { .function = fn } };
-    sm_rbtree_insert(&ctx->externals, &b);
+    external_slot(ctx, id)->function = fn;
+    sm_symbol_set_kind(id, SmSymbolExternalFunction);
 }
 
 void sm_context_register_variable(SmContext* ctx, SmSymbol id, SmExternalVariable var) {
-    External b = { id, Variable, { .variable = var } };
-    sm_rbtree_insert(&ctx->externals, &b);
+    external_slot(ctx, id)->variable = var;
+    sm_symbol_set_kind(id, SmSymbolExternalVariable);
 }
 
 void sm_context_unregister_external(SmContext* ctx, SmSymbol id) {
-    sm_rbtree_erase(&ctx->externals, sm_rbtree_find_by_key(&ctx->externals, sm_symbol_key(&id)));
-}
-
-SmExternalFunction sm_context_lookup_function(SmContext* ctx, SmSymbol id) {
-    External* b = (External*) sm_rbtree_find_by_key(&ctx->externals, sm_symbol_key(&id));
-    return (b && b->type == Function) ? b->fn.function : NULL;
-}
+    sm_unused(ctx);
 
-SmExternalVariable sm_context_lookup_variable(SmContext* ctx, SmSymbol id) {
-    External* b = (External*) sm_rbtree_find_by_key(&ctx->externals, sm_symbol_key(&id));
-    return (b && b->type == Variable) ? b->fn.variable : NULL;
+    // The slot stays assigned to the symbol for later registrations
+    if (sm_symbol_kind(id) == SmSymbolExternalFunction || sm_symbol_kind(id) == SmSymbolExternalVariable)
+        sm_symbol_set_kind(id, SmSymbolPlain);
 }
@@ -20,6 +20,7 @@ static char const* error_codes[SmErrorCount] = {
     "SyntaxError",
     "LexicalError",
     "InvalidLiteral",
+    "StackOverflow",
     "Generic"
 };
 
@@ -2,88 +2,247 @@
 #include "function.h"
 
 #include <stdio.h>
-#include <string.h>
 
 // Error message buffer
 static sm_thread_local char err_buf[1024];
 
-// Eval functions
-SmError sm_eval(SmContext* ctx, SmValue form, SmValue* ret) {
+// Private helpers
+static inline SmError eval_atom(SmContext* ctx, SmValue form, SmValue* ret) {
     // If quoted, just unquote
     if (sm_value_is_quoted(form)) {
         *ret = sm_value_unquote(form, 1);
         return sm_ok;
     }
 
+    // Return anything but symbols
+    if (!sm_value_is_symbol(form)) {
+        *ret = form;
+        return sm_ok;
+    }
+
     // Unquoted symbols trigger external/variable lookup
-    if (sm_value_is_symbol(form)) {
-        SmString var_name = sm_symbol_str(form.data.symbol);
+    switch (sm_symbol_kind(form.data.symbol)) {
+    case SmSymbolPlain:
+        break;
 
-        // keywords represent themselves
-        if (var_name.length && var_name.data[0] == ':') {
-            *ret = form;
-            return sm_ok;
-        }
+    // keywords represent themselves
+    case SmSymbolKeyword:
+        *ret = form;
+        return sm_ok;
+
+    // nil represents ()
+    case SmSymbolNil:
+        *ret = sm_value_nil();
+        return sm_ok;
+
+    // Call external variable
+    case SmSymbolExternalVariable:
+        return sm_context_lookup_variable(ctx, form.data.symbol)(ctx, ret);
+
+    // External functions are values by themselves
+    case SmSymbolExternalFunction:
+        *ret = sm_value_external(form.data.symbol);
+        return sm_ok;
+    }
+
+    // Lookup variable in scope
+    SmVariable* scope_var = sm_scope_lookup(ctx->scope, form.data.symbol);
+    if (scope_var) {
+        *ret = scope_var->value;
+        return sm_ok;
+    }
+
+    SmString var_name = sm_symbol_str(form.data.symbol);
+    snprintf(err_buf, sizeof(err_buf), "variable not found: %.*s", (int) var_name.length, var_name.data);
+    return sm_error(ctx, SmErrorUndefinedVariable, err_buf);
+}
+
+sm_noinline static SmError stack_overflow(SmContext* ctx) {
+    return sm_error(ctx, SmErrorStackOverflow, "maximum evaluation depth exceeded");
+}
+
+// Evaluation starting at depth 0 sets the limit of the native stack, which
+// is assumed to grow downwards
+static inline bool stack_exhausted(SmContext* ctx) {
+    const uintptr_t sp = sm_stack_address();
+
+    if (!ctx->depth)
+        ctx->stack_limit = (sp > ctx->stack_size) ? sp - ctx->stack_size : 0;
+
+    return sp < ctx->stack_limit;
+}
+
+// External functions called from here may hand back a form in tail position
+static inline SmError call_external(SmContext* ctx, SmExternalFunction fn, SmValue args, SmValue* ret) {
+    if (stack_exhausted(ctx))
+        return stack_overflow(ctx);
+
+    const size_t tail_depth = ctx->tail_depth;
+    ctx->tail_depth = ++ctx->depth;
+
+    SmError err = fn(ctx, args, ret);
+
+    ctx->tail_depth = tail_depth;
+    --ctx->depth;
+
+    return err;
+}
+
+// Evaluate form, following the forms external functions hand back, until
+// it yields a value or a call to a function is reached: then form is the
+// call, ret holds the function and apply is set
+sm_noinline static SmError eval_step(SmContext* ctx, SmValue* form, SmValue* ret, bool* apply) {
+    while (true) {
+        // Lists are interpreted as function/macro calls
+        if (!sm_value_is_cons(*form) || sm_value_is_quoted(*form))
+            return eval_atom(ctx, *form, ret);
+
+        SmCons* call = form->data.cons;
+        SmExternalFunction ext_fn = NULL;
+
+        // Call external function if possible
+        if (sm_value_is_symbol(call->car) && !sm_value_is_quoted(call->car))
+            ext_fn = sm_context_lookup_function(ctx, call->car.data.symbol);
+
+        if (!ext_fn) {
+            // Evaluate first element
+            SmError err = sm_eval(ctx, call->car, ret);
+            if (!sm_is_ok(err))
+                return err;
+
+            if (sm_value_is_function(*ret) && !sm_value_is_quoted(*ret)) {
+                *apply = true;
+                return sm_ok;
+            }
+
+            if (!sm_value_is_external(*ret) || sm_value_is_quoted(*ret))
+                return sm_error(ctx, SmErrorInvalidArgument, "first element of function call does not evaluate to a function");
+
+            // Call external function referenced through a value
+            ext_fn = sm_context_lookup_function(ctx, ret->data.symbol);
+            if (!ext_fn)
+                return sm_error(ctx, SmErrorUndefinedVariable, "external function is no longer registered");
 
-        // nil represents ()
-        if (var_name.length == 3 && strncmp(var_name.data, "nil", 3) == 0) {
             *ret = sm_value_nil();
-            return sm_ok;
         }
 
-        // Lookup external variable
-        SmExternalVariable ext_var = sm_context_lookup_variable(ctx, form.data.symbol);
-        if (ext_var)
-            return ext_var(ctx, ret);
-
-        // Lookup external function
-        if (sm_context_lookup_function(ctx, form.data.symbol)) {
-            // Return lambda wrapping the external function
-            SmSymbol args = sm_symbol(&ctx->symbols, sm_string_from_cstring("args"));
-
-            sm_build_list(ctx, ret,
-                SmBuildCar, sm_value_quote(sm_value_symbol(args), 1),
-                SmBuildList,
-                    SmBuildCar, sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring("eval"))),
-                    SmBuildList,
-                        SmBuildCar, sm_value_symbol(sm_symbol(&ctx->symbols, sm_string_from_cstring("cons"))),
-                        SmBuildCar, sm_value_quote(sm_value_symbol(form.data.symbol), 1),
-                        SmBuildCar, sm_value_symbol(args),
-                        SmBuildEnd,
-                    SmBuildEnd,
-                SmBuildEnd);
-
-            SmFunction* fn = sm_heap_alloc_function(&ctx->heap, ctx);
-            *fn = sm_function(var_name, ctx->scope, ret->data.cons);
-            *ret = sm_value_function(fn);
-            return sm_ok;
-        }
+        SmError err = call_external(ctx, ext_fn, call->cdr, ret);
+        if (!ctx->tail)
+            return err;
 
-        // Lookup variable in scope
-        SmVariable* scope_var = sm_scope_lookup(ctx->scope, form.data.symbol);
-        if (scope_var) {
-            *ret = scope_var->value;
-            return sm_ok;
-        }
+        // Evaluate the form handed back in place of the call
+        ctx->tail = false;
+        if (!sm_is_ok(err))
+            return err;
 
-        snprintf(err_buf, sizeof(err_buf), "variable not found: %.*s", (int) var_name.length, var_name.data);
-        return sm_error(ctx, SmErrorUndefinedVariable, err_buf);
+        *form = *ret;
+        *ret = sm_value_nil();
     }
+}
 
-    // Return anything but function calls
-    if (!sm_value_is_cons(form)) {
-        *ret = form;
-        return sm_ok;
+// Call the function in ret, then keep applying functions called in tail
+// position in place of the first one
+sm_noinline static SmError eval_call(SmContext* ctx, SmValue form, SmValue* ret) {
+    if (ctx->call_depth >= ctx->max_depth || stack_exhausted(ctx))
+        return stack_overflow(ctx);
+
+    ++ctx->depth;
+    ++ctx->call_depth;
+
+    // Root the call being evaluated and the function running it: tail
+    // calls replace both
+    SmValue roots[2];
+    SmHeapRootFrame root_frame;
+    sm_heap_root_frame_push(&ctx->heap, &root_frame, roots, 2);
+    roots[0] = form;
+    roots[1] = *ret;
+
+    // Frame of the first function called, reused by tail calls
+    SmStackFrame frame;
+    bool entered = false;
+
+    SmError err = sm_ok;
+
+    while (true) {
+        SmFunction* function = roots[1].data.function;
+        *ret = sm_value_nil();
+
+        if (function->macro) {
+            err = sm_function_invoke(function, ctx, form.data.cons->cdr, ret);
+            break;
+        }
+
+        SmScope* scope = NULL;
+        err = sm_function_bind(function, ctx, form.data.cons->cdr, &scope);
+        if (!sm_is_ok(err))
+            break;
+
+        // A tail call takes over the frame of the caller
+        if (!entered)
+            sm_context_enter_frame(ctx, &frame, function->args.name);
+        else
+            frame.name = function->args.name;
+
+        entered = true;
+        ctx->scope = scope;
+
+        err = sm_function_run(function, ctx, ret);
+        if (!ctx->tail)
+            break;
+
+        ctx->tail = false;
+        if (!sm_is_ok(err))
+            break;
+
+        // Evaluate the last form of the body in the same frame
+        form = roots[0] = *ret;
+        *ret = sm_value_nil();
+
+        bool apply = false;
+        err = eval_step(ctx, &form, ret, &apply);
+        if (!sm_is_ok(err) || !apply)
+            break;
+
+        roots[0] = form;
+        roots[1] = *ret;
     }
 
+    if (entered)
+        sm_context_exit_frame(ctx);
+
+    sm_heap_root_frame_pop(&ctx->heap, &root_frame);
+    --ctx->call_depth;
+    --ctx->depth;
+
+    return err;
+}
+
+// Evaluate the form an external function handed back in place of its call
+sm_noinline static SmError eval_handed_back(SmContext* ctx, SmError err, SmValue* ret) {
+    ctx->tail = false;
+    if (!sm_is_ok(err))
+        return err;
+
+    SmValue form = *ret;
+    *ret = sm_value_nil();
+    return sm_eval(ctx, form, ret);
+}
+
+// Eval functions
+SmError sm_eval(SmContext* ctx, SmValue form, SmValue* ret) {
     // Lists are interpreted as function/macro calls
+    if (!sm_value_is_cons(form) || sm_value_is_quoted(form))
+        return eval_atom(ctx, form, ret);
+
     SmCons* call = form.data.cons;
 
     // Call external function if possible
     if (sm_value_is_symbol(call->car) && !sm_value_is_quoted(call->car)) {
         SmExternalFunction ext_fn = sm_context_lookup_function(ctx, call->car.data.symbol);
-        if (ext_fn)
-            return ext_fn(ctx, call->cdr, ret);
+        if (ext_fn) {
+            SmError err = call_external(ctx, ext_fn, call->cdr, ret);
+            return ctx->tail ? eval_handed_back(ctx, err, ret) : err;
+        }
     }
 
     // Evaluate first element
@@ -91,17 +250,28 @@ SmError sm_eval(SmContext* ctx, SmValue form, SmValue* ret) {
     if (!sm_is_ok(err))
         return err;
 
+    // Call external function referenced through a value
+    if (sm_value_is_external(*ret) && !sm_value_is_quoted(*ret)) {
+        SmExternalFunction ext_fn = sm_context_lookup_function(ctx, ret->data.symbol);
+        if (!ext_fn)
+            return sm_error(ctx, SmErrorUndefinedVariable, "external function is no longer registered");
+
+        *ret = sm_value_nil();
+        err = call_external(ctx, ext_fn, call->cdr, ret);
+        return ctx->tail ? eval_handed_back(ctx, err, ret) : err;
+    }
+
     if (!sm_value_is_function(*ret) || sm_value_is_quoted(*ret))
         return sm_error(ctx, SmErrorInvalidArgument, "first element of function call does not evaluate to a function");
 
-    // Call function
-    SmValue* fn = sm_heap_root_value(&ctx->heap);
-    *fn = *ret;
-
-    *ret = sm_value_nil();
-    err = sm_function_invoke(fn->data.function, ctx, call->cdr, ret);
+    return eval_call(ctx, form, ret);
+}
 
-    sm_heap_root_value_drop(&ctx->heap, ctx, fn);
+SmError sm_eval_tail(SmContext* ctx, SmValue form, SmValue* ret) {
+    if (ctx->tail_depth != ctx->depth)
+        return sm_eval(ctx, form, ret);
 
-    return err;
+    *ret = form;
+    ctx->tail = true;
+    return sm_ok;
 }
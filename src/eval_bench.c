@@ -0,0 +1,87 @@
+#include "builtins.h"
+#include "context.h"
+#include "eval.h"
+#include "parser.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static double elapsed(uint64_t start) {
+    return ((double) (sm_clock_ns() - start))/1e9;
+}
+
+// Parse a single form into a rooted value
+static SmValue* parse(SmContext* ctx, char const* source) {
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+    SmParser parser = sm_parser(sm_string_from_cstring("<bench>"), sm_string_from_cstring(source));
+
+    SmError err = sm_parser_parse_form(&parser, ctx, form);
+    sm_guard(sm_is_ok(err), "parse failed");
+
+    return form;
+}
+
+// Evaluate a form repeatedly, as a loop body would be
+static double bench_eval(SmContext* ctx, char const* source, size_t iterations) {
+    SmValue* form = parse(ctx, source);
+    SmValue* ret = sm_heap_root_value(&ctx->heap);
+
+    const uint64_t start = sm_clock_ns();
+    for (size_t i = 0; i < iterations; ++i) {
+        SmError err = sm_eval(ctx, *form, ret);
+        sm_guard(sm_is_ok(err), "evaluation failed");
+    }
+    const double time = elapsed(start);
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, ret);
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+
+    return time;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t iterations = (argc > 1) ? (size_t) strtoull(argv[1], NULL, 10) : 10000000;
+
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+
+    bench_eval(ctx, "(set 'x '(41 42))", 1);
+    bench_eval(ctx, "(set 'f car)", 1);
+
+    printf("builtin call (+ (car x) 1): %zu iterations: %.3f s\n",
+        iterations, bench_eval(ctx, "(+ (car x) 1)", iterations));
+    printf("variable reference x:       %zu iterations: %.3f s\n",
+        iterations, bench_eval(ctx, "x", iterations));
+    printf("builtin reference car:      %zu iterations: %.3f s\n",
+        iterations, bench_eval(ctx, "car", iterations));
+    printf("builtin through var (f x):  %zu iterations: %.3f s\n",
+        iterations, bench_eval(ctx, "(f x)", iterations));
+
+    // Recursive lambda, interpreted then compiled
+    bench_eval(ctx, "(set 'fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))", 1);
+
+    ctx->bytecode = false;
+    printf("(fib 25) tree walker:       %.3f s\n", bench_eval(ctx, "(fib 25)", 1));
+
+    ctx->bytecode = true;
+    printf("(fib 25) bytecode:          %.3f s\n", bench_eval(ctx, "(fib 25)", 1));
+
+    // A fresh closure applied once per iteration
+    bench_eval(ctx, "(set 'loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) ((lambda (x y) (+ x y)) n acc)))))", 1);
+
+    ctx->bytecode = false;
+    printf("(loop 300000 0) tree walker: %.3f s\n", bench_eval(ctx, "(loop 300000 0)", 1));
+
+    ctx->bytecode = true;
+    printf("(loop 300000 0) bytecode:    %.3f s\n", bench_eval(ctx, "(loop 300000 0)", 1));
+
+    // Arguments and captured variables are resolved to slots
+    bench_eval(ctx, "(set 'poly (let ((j 3) (k 5)) (lambda (a b c d) (+ (* a j) (* b k) (* c j) (* d k) a b c d))))", 1);
+    printf("closure (poly 1 2 3 4):     %zu iterations: %.3f s\n",
+        iterations/10, bench_eval(ctx, "(poly 1 2 3 4)", iterations/10));
+
+    sm_context_drop(ctx);
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include "builtins.h"
+#include "context.h"
+#include "eval.h"
+#include "parser.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Enough to exhaust the native stack without tail calls. Pass a count on
+// the command line for longer runs, e.g. 100000000 in release builds
+#define TAIL_ITERATIONS 100000
+
+typedef struct Result {
+    SmError err;
+    SmValue* value;
+} Result;
+
+// Evaluate every form in source, keep the result of the last one
+static Result run(SmContext* ctx, char const* source) {
+    SmValue* forms = sm_heap_root_value(&ctx->heap);
+    Result res = { sm_ok, sm_heap_root_value(&ctx->heap) };
+
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+    res.err = sm_parser_parse_all(&parser, ctx, forms);
+
+    for (SmCons* form = forms->data.cons; sm_is_ok(res.err) && form; form = sm_list_next(form)) {
+        *res.value = sm_value_nil();
+        res.err = sm_eval(ctx, form->car, res.value);
+    }
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, forms);
+    return res;
+}
+
+// Run source in a fresh context, expect an integer result
+static bool returns_int(bool bytecode, char const* source, int64_t expected) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+    ctx->bytecode = bytecode;
+
+    Result res = run(ctx, source);
+
+    // Tail calls must leave the context as they found it
+    const bool ok = sm_is_ok(res.err) &&
+        sm_value_is_number(*res.value) && sm_number_is_int(res.value->data.number) &&
+        res.value->data.number.value.i == expected &&
+        ctx->frame == &ctx->main && ctx->scope == &ctx->globals &&
+        ctx->depth == 0 && ctx->call_depth == 0 && !ctx->tail;
+
+    if (!sm_is_ok(res.err))
+        fprintf(stderr, "%.*s\n", (int) res.err.message.length, res.err.message.data);
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, res.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Run source in a fresh context with the given depth limit, expect it to
+// fail with code (or succeed for SmErrorOk) and leave the context usable
+static bool fails_with(bool bytecode, size_t max_depth, char const* source, SmErrorCode code) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+    ctx->bytecode = bytecode;
+    ctx->max_depth = max_depth;
+
+    Result res = run(ctx, source);
+    Result after = run(ctx, "(+ 1 2)");
+
+    const bool ok = res.err.code == code &&
+        ctx->frame == &ctx->main && ctx->scope == &ctx->globals &&
+        ctx->depth == 0 && ctx->call_depth == 0 && !ctx->tail &&
+        sm_is_ok(after.err) && after.value->data.number.value.i == 3;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, after.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, res.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Symbols made by gensym should carry a full header, not whatever follows
+// their slot in the heap
+static bool gensym_is_plain(void) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+
+    Result res = run(ctx, "(set 'a (gensym)) (set 'b (gensym)) a");
+
+    const bool ok = sm_is_ok(res.err) && sm_value_is_symbol(*res.value) &&
+        sm_symbol_kind(res.value->data.symbol) == SmSymbolPlain &&
+        sm_symbol_slot(res.value->data.symbol) == 0;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, res.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Builtins referenced by name are external values printed with their name
+static bool external_prints(void) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+
+    Result res = run(ctx, "car");
+
+    char buf[32] = { 0 };
+    FILE* file = tmpfile();
+    bool ok = file && sm_is_ok(res.err) && sm_value_is_external(*res.value);
+
+    if (ok) {
+        sm_print_value(file, *res.value);
+        rewind(file);
+        ok = fgets(buf, sizeof(buf), file) && strcmp(buf, "<external:car>") == 0;
+    }
+
+    if (file)
+        fclose(file);
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, res.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Calling a value whose external has been unregistered since must fail
+static bool external_unregistered(bool bytecode) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+    ctx->bytecode = bytecode;
+
+    Result ref = run(ctx, "(set 'f car) (set 'g (lambda (x) (f x))) (g '(1 2))");
+    sm_context_unregister_external(ctx, sm_symbol(&ctx->symbols, sm_string_from_cstring("car")));
+    Result call = run(ctx, "(f '(1 2))");
+    Result nested = run(ctx, "(g '(1 2))");
+
+    const bool ok = sm_is_ok(ref.err) && ref.value->data.number.value.i == 1 &&
+        call.err.code == SmErrorUndefinedVariable &&
+        nested.err.code == SmErrorUndefinedVariable &&
+        ctx->frame == &ctx->main && ctx->scope == &ctx->globals && ctx->depth == 0;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, nested.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, call.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, ref.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+static SmError external_one(SmContext* ctx, SmValue args, SmValue* ret) {
+    sm_unused(ctx);
+    sm_unused(args);
+    *ret = sm_value_number(sm_number_int(1));
+    return sm_ok;
+}
+
+static SmError external_two(SmContext* ctx, SmValue* ret) {
+    sm_unused(ctx);
+    *ret = sm_value_number(sm_number_int(2));
+    return sm_ok;
+}
+
+// Unregistering keeps the slot of a symbol, later registrations reuse it
+static bool externals_reuse_slots(bool bytecode) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    sm_register_builtins(ctx);
+    ctx->bytecode = bytecode;
+
+    SmSymbol id = sm_symbol(&ctx->symbols, sm_string_from_cstring("ext"));
+
+    sm_context_register_function(ctx, id, external_one);
+    const uint32_t slot = sm_symbol_slot(id);
+    const size_t size = ctx->externals.size;
+    Result first = run(ctx, "(ext)");
+
+    sm_context_unregister_external(ctx, id);
+    Result gone = run(ctx, "(ext)");
+
+    sm_context_register_variable(ctx, id, external_two);
+    Result second = run(ctx, "ext");
+
+    // Symbols made by gensym get a fresh slot of their own
+    Result gensym = run(ctx, "(gensym)");
+    sm_context_register_function(ctx, gensym.value->data.symbol, external_one);
+
+    const bool ok = sm_is_ok(first.err) && first.value->data.number.value.i == 1 &&
+        !sm_is_ok(gone.err) &&
+        sm_is_ok(second.err) && second.value->data.number.value.i == 2 &&
+        sm_symbol_slot(id) == slot &&
+        sm_symbol_slot(gensym.value->data.symbol) == size &&
+        ctx->externals.size == size + 1 &&
+        sm_context_lookup_function(ctx, gensym.value->data.symbol) == external_one;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, gensym.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, second.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, gone.value);
+    sm_heap_root_value_drop(&ctx->heap, ctx, first.value);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    SmTestContext ctx = sm_test_context(argc, argv);
+
+    const int64_t iterations = (argc > 1) ? (int64_t) strtoll(argv[1], NULL, 10) : TAIL_ITERATIONS;
+
+    char counter[256];
+    snprintf(counter, sizeof(counter),
+        "(set 'count (lambda (n acc) (if (= n 0) acc (count (- n 1) (+ acc 1)))))"
+        "(count %lld 0)", (long long) iterations);
+
+    sm_test(&ctx, "tail-recursive loops should run in constant space",
+        returns_int(true, counter, iterations));
+
+    sm_test(&ctx, "tail calls should work without bytecode",
+        returns_int(false,
+            "(set 'count (lambda (n acc) (if (= n 0) acc (count (- n 1) (+ acc 1)))))"
+            "(count 100000 0)", 100000));
+
+    sm_test(&ctx, "last forms of progn, and, or should be tail positions",
+        returns_int(true,
+            "(set 'down (lambda (n) (progn n (if (= n 0) 7 (and n (or nil (down (- n 1))))))))"
+            "(down 100000)", 7) &&
+        returns_int(false,
+            "(set 'down (lambda (n) (progn n (if (= n 0) 7 (and n (or nil (down (- n 1))))))))"
+            "(down 100000)", 7));
+
+    sm_test(&ctx, "mutually recursive tail calls should run in constant space",
+        returns_int(true,
+            "(set 'ping (lambda (n) (if (= n 0) 1 (pong (- n 1)))))"
+            "(set 'pong (lambda (n) (if (= n 0) 2 (ping (- n 1)))))"
+            "(ping 100001)", 2));
+
+    sm_test(&ctx, "calls out of tail position should return to their caller",
+        returns_int(true,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 100)", 5050) &&
+        returns_int(true,
+            "(set 'f (lambda (x) (let ((y (* x 2))) (+ y 1))))"
+            "(+ (f 1) (f 2))", 8));
+
+    sm_test(&ctx, "deep recursion should fail with a stack overflow error",
+        fails_with(true, SM_CONTEXT_MAX_DEPTH,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 100000)", SmErrorStackOverflow) &&
+        fails_with(false, SM_CONTEXT_MAX_DEPTH,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 100000)", SmErrorStackOverflow) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH,
+            "(set 'nest (lambda (n) (if (= n 0) 0 (list (let ((m (nest (- n 1)))) m)))))"
+            "(nest 100000)", SmErrorStackOverflow));
+
+    // Above the depth both evaluators used to stop at, within what the
+    // native stack holds in sanitized builds
+    sm_test(&ctx, "recursion the native stack can hold should succeed",
+        returns_int(true,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 2500)", 3126250) &&
+        returns_int(false,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 1500)", 1125750));
+
+    // Each lambda level counts once in both evaluators, (sum n) takes n + 1
+    sm_test(&ctx, "the maximum depth should be configurable",
+        fails_with(true, 10,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 10)", SmErrorStackOverflow) &&
+        fails_with(false, 10,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 10)", SmErrorStackOverflow) &&
+        fails_with(true, 10,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 9)", SmErrorOk) &&
+        fails_with(false, 10,
+            "(set 'sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))"
+            "(sum 9)", SmErrorOk));
+
+    sm_test(&ctx, "builtins should evaluate long and dotted argument lists",
+        returns_int(true, "(+ 1 2 3 4 5 6 7 8 9 10 11 12)", 78) &&
+        returns_int(false, "(set 'rest (list 3 4 5 6 7 8 9 10)) (+ 1 2 . rest)", 55) &&
+        returns_int(true, "(* 2 . '(3 4))", 24) &&
+        returns_int(true, "(if (< (car (list 1 2 3 4 5 6 7 8 9)) . '(2)) 1 0)", 1));
+
+    sm_test(&ctx, "builtins should reject argument lists not matching their pattern",
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "(< 1)", SmErrorMissingArguments) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "(< 1 2 3)", SmErrorExcessArguments) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "(< 1 2 . 3)", SmErrorInvalidArgument) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "(+ 1 2 3 4 5 6 7 8 9 undefined)", SmErrorUndefinedVariable));
+
+    sm_test(&ctx, "lambda arguments should bind through every plan",
+        returns_int(true, "((lambda (a 'b) (+ a (car b))) 1 (2))", 3) &&
+        returns_int(true, "(set 'rest (list 2)) ((lambda (a b) (+ a b)) 1 . rest)", 3) &&
+        returns_int(true, "((lambda 'r (car r)) 5 undefined)", 5) &&
+        returns_int(true, "((lambda r (car (cdr r))) 5 (+ 1 2))", 3) &&
+        returns_int(true, "((lambda (a . r) (+ a (car r))) 1 2)", 3) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "((lambda (a b) a) 1)", SmErrorMissingArguments) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "((lambda (a) a) 1 2)", SmErrorExcessArguments) &&
+        fails_with(true, SM_CONTEXT_MAX_DEPTH, "((lambda (a) a) 1 . 2)", SmErrorInvalidArgument));
+
+    char const* const gensyms =
+        "(set 'a (gensym)) (set 'b (gensym))"
+        "(set a 5) (set b (lambda (x) (+ x 1)))"
+        "(+ (eval a) (eval (list b 4)) (eval (list (list 'lambda (list a) a) 7)))";
+    sm_test(&ctx, "gensyms should work as variables and function names",
+        gensym_is_plain() &&
+        returns_int(true, gensyms, 17) &&
+        returns_int(false, gensyms, 17));
+
+    sm_test(&ctx, "external functions should be first-class values",
+        external_prints() &&
+        returns_int(true, "(set 'f car) (f '(4 5))", 4) &&
+        returns_int(false, "(set 'f car) (f '(4 5))", 4) &&
+        returns_int(true, "(set 'apply1 (lambda (g x) (g x))) (apply1 car '(6 7))", 6) &&
+        returns_int(false, "(set 'apply1 (lambda (g x) (g x))) (apply1 car '(6 7))", 6));
+
+    sm_test(&ctx, "calling an unregistered external function should fail",
+        external_unregistered(true) &&
+        external_unregistered(false));
+
+    sm_test(&ctx, "externals should keep their slot when registered again",
+        externals_reuse_slots(true) &&
+        externals_reuse_slots(false));
+
+    return !sm_test_report(&ctx);
+}
@@ -7,48 +7,92 @@ extern inline SmFunction sm_function(SmString name, SmScope* capture, SmCons* la
 extern inline SmFunction sm_macro(SmString name, SmScope* capture, SmCons* lambda);
 extern inline void sm_function_drop(SmFunction* function);
 
-SmError sm_function_invoke(SmFunction const* function, SmContext* ctx, SmValue args, SmValue* ret) {
+SmError sm_function_bind(SmFunction* function, SmContext* ctx, SmValue args, SmScope** scope) {
     SmScope** arg_scope = (SmScope**) sm_heap_root(&ctx->heap);
     *arg_scope = sm_heap_alloc_scope(&ctx->heap, ctx);
     (*arg_scope)->parent = function->capture;
 
     // Unpack arguments into scope
     SmError err = sm_arg_pattern_unpack(&function->args, ctx, *arg_scope, args);
-    if (!sm_is_ok(err)) {
-        sm_heap_root_drop(&ctx->heap, ctx, (void**) arg_scope);
-        return err;
+    if (sm_is_ok(err)) {
+        sm_scope_seal(*arg_scope);
+        *scope = *arg_scope;
     }
 
-    SmStackFrame frame;
-    sm_context_enter_frame(ctx, &frame, function->args.name);
-    ctx->scope = *arg_scope;
+    sm_heap_root_drop(&ctx->heap, ctx, (void**) arg_scope);
+    return err;
+}
 
+SmError sm_function_run(SmFunction* function, SmContext* ctx, SmValue* ret) {
     // Return nil when code list is empty
     *ret = sm_value_nil();
 
-    // Run each form in code list, return result of last one
+    if (!function->macro && ctx->bytecode && !sm_bytecode_is_compiled(&function->code) &&
+        ++function->calls > ctx->compile_calls)
+    {
+        function->code = sm_bytecode_compile(ctx, ctx->scope, function->progn);
+
+        // Constants may be younger than the function
+        sm_heap_write_barrier(&ctx->heap, function);
+    }
+
+    if (sm_bytecode_is_compiled(&function->code))
+        return sm_bytecode_run(&function->code, ctx, ret);
+
+    // Run each form in code list, leave the last one to the caller
     for (SmCons* form = function->progn; form; form = sm_list_next(form)) {
+        if (!sm_list_next(form)) {
+            *ret = form->car;
+            ctx->tail = true;
+            break;
+        }
+
         *ret = sm_value_nil();
-        err = sm_eval(ctx, form->car, ret);
+        SmError err = sm_eval(ctx, form->car, ret);
         if (!sm_is_ok(err))
-            break;
+            return err;
+    }
+
+    return sm_ok;
+}
+
+SmError sm_function_invoke(SmFunction* function, SmContext* ctx, SmValue args, SmValue* ret) {
+    SmScope* scope = NULL;
+    SmError err = sm_function_bind(function, ctx, args, &scope);
+    if (!sm_is_ok(err))
+        return err;
+
+    SmStackFrame frame;
+    sm_context_enter_frame(ctx, &frame, function->args.name);
+    ctx->scope = scope;
+
+    // The last form is reachable from the function, rooted by the caller
+    err = sm_function_run(function, ctx, ret);
+    if (ctx->tail) {
+        ctx->tail = false;
+
+        SmValue form = *ret;
+        *ret = sm_value_nil();
+        if (sm_is_ok(err))
+            err = sm_eval(ctx, form, ret);
     }
 
     sm_context_exit_frame(ctx);
-    sm_heap_root_drop(&ctx->heap, ctx, (void**) arg_scope);
 
     // Evaluate macro result in parent scope
     if (function->macro) {
         // Enter frame again (for better error reporting)
         sm_context_enter_frame(ctx, &frame, function->args.name);
 
-        SmValue* form = sm_heap_root_value(&ctx->heap);
-        *form = *ret;
+        SmValue form;
+        SmHeapRootFrame roots;
+        sm_heap_root_frame_push(&ctx->heap, &roots, &form, 1);
+        form = *ret;
 
         *ret = sm_value_nil();
-        err = sm_eval(ctx, *form, ret);
+        err = sm_eval(ctx, form, ret);
 
-        sm_heap_root_value_drop(&ctx->heap, ctx, form);
+        sm_heap_root_frame_pop(&ctx->heap, &roots);
 
         sm_context_exit_frame(ctx);
     }
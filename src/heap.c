@@ -2,39 +2,99 @@
 #include "heap.h"
 #include "private/heap.h"
 
+#include "hash.h"
 #include "util.h"
 
 #include <stdint.h>
+#include <string.h>
 
 // Inlines
 extern inline SmHeap sm_heap(SmGCConfig gc);
 extern inline size_t sm_heap_size(SmHeap const* heap);
 extern inline size_t sm_heap_threshold(SmHeap const* heap);
+extern inline SmGCStats const* sm_heap_stats(SmHeap const* heap);
+extern inline void sm_heap_set_gc_callback(SmHeap* heap, SmGCCallback fn, void* data);
+extern inline SmGCPacing sm_heap_pacing(SmHeap const* heap);
+extern inline void sm_heap_root_frame_push(SmHeap* heap, SmHeapRootFrame* frame, SmValue* values, size_t count);
+extern inline void sm_heap_root_frame_pop(SmHeap* heap, SmHeapRootFrame* frame);
 
 // Private helpers
-static inline bool should_collect(struct SmGCStatus const* gc) {
-    return (gc->object_count >= gc->object_threshold) ||
-           (gc->unref_count >= gc->config.unref_threshold);
-}
-
-static Object* object_new(Type type, size_t size) {
-    size += offsetof(Object, data);
-    if (size < sizeof(Object))
-        size = sizeof(Object);
-
-    Object* obj = sm_aligned_alloc(sm_alignof(Object), size);
-    *obj = (Object){
-        NULL, NULL, NULL,
-        false, false, type, 1,
-        ((uintptr_t) obj) + size,
-        (uintptr_t) obj,
-        ((uintptr_t) obj) + size,
-        { .string = '\0' }
-    };
+static inline void collect_if_needed(SmHeap* heap, SmContext const* ctx) {
+    struct SmGCStatus const* gc = &heap->gc;
+
+    // Full collections when the heap outgrows its threshold, minor ones
+    // in between when enabled
+    if (gc->bytes >= gc->threshold)
+        sm_heap_gc(heap, ctx);
+    else if (gc->config.nursery_size && gc->young_bytes >= gc->config.nursery_size)
+        sm_heap_gc_minor(heap, ctx);
+}
+
+
+// Slab helpers
+static inline size_t round_up(size_t size, size_t alignment) {
+    return ((size + alignment - 1)/alignment)*alignment;
+}
+
+static inline size_t slot_size(size_t payload) {
+    return round_up(payload, sm_alignof(Object));
+}
+
+static inline size_t bitmap_words(size_t capacity) {
+    return (capacity + 63)/64;
+}
+
+static inline size_t chunk_header_size(size_t capacity) {
+    return round_up(sizeof(Chunk) + 4*bitmap_words(capacity)*sizeof(uint64_t), sm_alignof(Object));
+}
+
+// Number of slots fitting a single page along with header and bitmaps
+static size_t chunk_capacity(size_t slot_size) {
+    size_t capacity = (CHUNK_SIZE - sizeof(Chunk))/slot_size;
+
+    while (chunk_header_size(capacity) + capacity*slot_size > CHUNK_SIZE)
+        --capacity;
+
+    return capacity;
+}
+
+static inline Object* chunk_slot(Chunk const* chunk, size_t index) {
+    return (Object*) (chunk->slots + index*chunk->slot_size);
+}
+
+static inline bool bit_test(uint64_t const* bits, size_t index) {
+    return (bits[index/64] >> (index % 64)) & 1;
+}
+
+static inline void bit_set(uint64_t* bits, size_t index) {
+    bits[index/64] |= UINT64_C(1) << (index % 64);
+}
+
+static inline void bit_clear(uint64_t* bits, size_t index) {
+    bits[index/64] &= ~(UINT64_C(1) << (index % 64));
+}
+
+static inline bool chunk_full(Chunk const* chunk) {
+    return !chunk->free && chunk->top == chunk->capacity;
+}
+
+static size_t string_class(size_t length) {
+    size_t index = ClassString;
+
+    for (size_t size = STRING_CLASS_MIN; size < length; size *= 2)
+        ++index;
+
+    return index;
+}
+
+static inline size_t string_class_size(size_t index) {
+    return STRING_CLASS_MIN << (index - ClassString);
+}
 
+static void object_init(Object* obj, Type type) {
     switch (type) {
         case Symbol:
-            obj->data.symbol = (SmString){ NULL, 0 };
+            obj->data.symbol = (SmSymbolHeader){ { NULL, 0 }, 0, SmSymbolPlain, 0 };
             break;
         case Cons:
             obj->data.cons = (SmCons){ sm_value_nil(), sm_value_nil() };
@@ -44,583 +104,900 @@ static Object* object_new(Type type, size_t size) {
             break;
         case Function:
             obj->data.function = (SmFunction){
-                false, { { NULL, 0 }, NULL, 0, { NULL, false, false} },
-                NULL, NULL
+                false, { { NULL, 0 }, NULL, 0, { NULL, false, false}, SmArgPlanGeneral },
+                NULL, NULL, sm_bytecode(), 0
             };
             break;
         default:
+            obj->data.string = '\0';
             break;
     }
-
-    return obj;
 }
 
-static void object_drop(Object* obj) {
-    if (obj->type == Scope)
+static void object_drop(Type type, Object* obj) {
+    if (type == Scope)
         sm_scope_drop(&obj->data.scope);
-    else if (obj->type == Function)
+    else if (type == Function)
         sm_function_drop(&obj->data.function);
+}
 
-    free(obj);
+// Page table: open addressing with linear probing, keyed by page address
+static inline size_t page_index(SmHeapPageTable const* table, uintptr_t address) {
+    // Fibonacci hashing of the page number
+    const uint64_t hash = ((uint64_t) (address/CHUNK_SIZE))*UINT64_C(0x9E3779B97F4A7C15);
+    return ((size_t) (hash >> 32)) & (table->capacity - 1);
 }
 
-static inline Object** object_slot(Object** root, Object* obj) {
-    return (!obj->parent) ? root :
-        (obj == obj->parent->left) ? &obj->parent->left : &obj->parent->right;
+static void page_table_insert(SmHeapPageTable* table, uintptr_t address, Chunk* chunk);
+
+static void page_table_grow(SmHeapPageTable* table) {
+    SmHeapPageTable old = *table;
+
+    table->capacity = old.capacity ? 2*old.capacity : 64;
+    table->count = 0;
+    table->entries = calloc(table->capacity, sizeof(Page));
+    sm_guard(table->entries != NULL, "allocation failed");
+
+    for (size_t i = 0; i < old.capacity; ++i)
+        if (old.entries[i].address)
+            page_table_insert(table, old.entries[i].address, old.entries[i].chunk);
+
+    free(old.entries);
 }
 
-static Object* object_rotate_left(Object* obj) {
-    Object* r = obj->right;
-    Object* p = obj->parent;
+static void page_table_insert(SmHeapPageTable* table, uintptr_t address, Chunk* chunk) {
+    // Keep load factor at most 1/2
+    if (2*(table->count + 1) > table->capacity)
+        page_table_grow(table);
 
-    sm_assert(r != NULL);
+    const size_t mask = table->capacity - 1;
+    size_t i = page_index(table, address);
 
-    obj->right = r->left;
-    r->left = obj;
-    obj->parent = r;
-    r->parent = p;
+    while (table->entries[i].address)
+        i = (i + 1) & mask;
 
-    if (obj->right)
-        obj->right->parent = obj;
+    table->entries[i] = (Page){ address, chunk };
+    ++table->count;
+}
 
-    // Update bounds
-    obj->upper_bound = obj->right ? obj->right->upper_bound : obj->end;
-    r->lower_bound = obj->lower_bound;
+static void page_table_erase(SmHeapPageTable* table, uintptr_t address) {
+    const size_t mask = table->capacity - 1;
+    size_t i = page_index(table, address);
 
-    // Update height
-    size_t lh = obj->left ? obj->left->height : 0;
-    size_t rh = obj->right ? obj->right->height : 0;
-    obj->height = 1 + ((lh < rh) ? rh : lh);
+    while (table->entries[i].address != address)
+        i = (i + 1) & mask;
 
-    rh = r->right ? r->right->height : 0;
-    r->height = 1 + ((obj->height < rh) ? rh : obj->height);
+    // Shift back following entries that would become unreachable
+    for (size_t j = (i + 1) & mask; table->entries[j].address; j = (j + 1) & mask) {
+        const size_t home = page_index(table, table->entries[j].address);
 
-    return r;
+        if ((i < j) ? (home <= i || home > j) : (home <= i && home > j)) {
+            table->entries[i] = table->entries[j];
+            i = j;
+        }
+    }
+
+    table->entries[i] = (Page){ 0, NULL };
+    --table->count;
+}
+
+static Chunk* chunk_from_pointer(SmHeapPageTable const* table, void const* ptr) {
+    if (!table->count)
+        return NULL;
+
+    const size_t mask = table->capacity - 1;
+    const uintptr_t address = ((uintptr_t) ptr) & CHUNK_MASK;
+
+    // The null page is never mapped, empty entries stop the probe
+    for (size_t i = page_index(table, address); table->entries[i].address; i = (i + 1) & mask)
+        if (table->entries[i].address == address)
+            return table->entries[i].chunk;
+
+    return NULL;
+}
+
+static Chunk* chunk_new(SmHeap* heap, Type type, size_t slot_size, size_t capacity) {
+    const size_t header = chunk_header_size(capacity);
+    const size_t size = round_up(header + capacity*slot_size, CHUNK_SIZE);
+
+    // Chunks must be aligned to CHUNK_SIZE
+    #if (__STDC_VERSION__ >= 201112L)
+        void* base = aligned_alloc(CHUNK_SIZE, size);
+        Chunk* chunk = base;
+    #else
+        void* base = malloc(size + CHUNK_SIZE - 1);
+        Chunk* chunk = (Chunk*) ((((uintptr_t) base) + CHUNK_SIZE - 1) & CHUNK_MASK);
+    #endif
+    sm_guard(base != NULL, "allocation failed");
+
+    const size_t words = bitmap_words(capacity);
+    uint64_t* bits = (uint64_t*) (((uint8_t*) chunk) + sizeof(Chunk));
+
+    *chunk = (Chunk){
+        NULL,
+        base, size/CHUNK_SIZE,
+        type, slot_size, capacity, 0, 0, false,
+        words, bits, bits + words, bits + 2*words, bits + 3*words,
+        ((uint8_t*) chunk) + header,
+        NULL
+    };
+
+    memset(bits, 0, 4*words*sizeof(uint64_t));
+
+    // Register every page so interior pointers of large chunks resolve too
+    for (size_t i = 0; i < chunk->pages; ++i)
+        page_table_insert(&heap->pages, ((uintptr_t) chunk) + i*CHUNK_SIZE, chunk);
+
+    return chunk;
 }
 
-static Object* object_rotate_right(Object* obj) {
-    Object* l = obj->left;
-    Object* p = obj->parent;
+static void chunk_free(SmHeap* heap, Chunk* chunk) {
+    for (size_t i = 0; i < chunk->pages; ++i)
+        page_table_erase(&heap->pages, ((uintptr_t) chunk) + i*CHUNK_SIZE);
 
-    sm_assert(l != NULL);
+    free(chunk->base);
+}
 
-    obj->left = l->right;
-    l->right = obj;
-    obj->parent = l;
-    l->parent = p;
+// Find the slot of a live object in a chunk containing the given pointer,
+// return the chunk capacity when there is none
+static size_t slot_from_pointer(Chunk const* chunk, void const* ptr) {
+    const uintptr_t slots = (uintptr_t) chunk->slots;
+    if ((uintptr_t) ptr < slots)
+        return chunk->capacity;
 
-    if (obj->left)
-        obj->left->parent = obj;
+    const size_t index = ((uintptr_t) ptr - slots)/chunk->slot_size;
+    if (index >= chunk->top || !bit_test(chunk->live_bits, index))
+        return chunk->capacity;
 
-    // Update bounds
-    obj->lower_bound = obj->left ? obj->left->lower_bound : ((uintptr_t) obj);
-    l->upper_bound = obj->upper_bound;
+    // Unmarked objects in chunks pending sweep are dead already
+    if (chunk->unswept && !bit_test(chunk->mark_bits, index))
+        return chunk->capacity;
 
-    // Update height
-    size_t lh = obj->left ? obj->left->height : 0;
-    size_t rh = obj->right ? obj->right->height : 0;
-    obj->height = 1 + ((lh < rh) ? rh : lh);
+    return index;
+}
 
-    lh = l->left ? l->left->height : 0;
-    l->height = 1 + ((lh < obj->height) ? obj->height : lh);
+// Everything in chunks pending sweep survived the last full collection
+static inline bool object_is_old(Chunk const* chunk, size_t index) {
+    return chunk->unswept || bit_test(chunk->old_bits, index);
+}
 
-    return l;
+static inline void object_free(Chunk* chunk, Object* obj) {
+    object_drop(chunk->type, obj);
+    obj->data.next = chunk->free;
+    chunk->free = obj;
 }
 
-static void object_insert(Object** root, Object* obj) {
-    Object** insp = root;
-    obj->parent = NULL;
+// Sweep a single chunk after a full collection: drop unmarked objects,
+// thread their slots on the free list, age survivors and clear marks.
+// Return number of freed objects
+static size_t chunk_sweep(Chunk* chunk) {
+    size_t freed = 0;
 
-    // Find insertion point (assume node is not in tree already)
-    // While descending, update bounds
-    while (*insp) {
-        obj->parent = *insp;
-        if (obj < *insp) {
-            if ((*insp)->lower_bound > obj->lower_bound)
-                (*insp)->lower_bound = obj->lower_bound;
-            insp = &(*insp)->left;
-        } else {
-            if ((*insp)->upper_bound < obj->upper_bound)
-                (*insp)->upper_bound = obj->upper_bound;
-            insp = &(*insp)->right;
-        }
+    for (size_t w = 0; w < chunk->words; ++w) {
+        uint64_t dead = chunk->live_bits[w] & ~chunk->mark_bits[w];
+        chunk->live_bits[w] &= chunk->mark_bits[w];
+        chunk->old_bits[w] = chunk->live_bits[w];
+
+        for (; dead; dead &= dead - 1, ++freed)
+            object_free(chunk, chunk_slot(chunk, w*64 + sm_ctz64(dead)));
     }
 
-    // Insert node
-    *insp = obj;
+    memset(chunk->mark_bits, 0, chunk->words*sizeof(uint64_t));
 
-    // Rebalance AVL tree
-    for (Object* p = obj->parent; p; p = p->parent) {
-        const size_t lh = p->left ? p->left->height : 0;
-        const size_t rh = p->right ? p->right->height : 0;
-        p->height = 1 + ((lh < rh) ? rh : lh);
+    chunk->live -= freed;
+    chunk->unswept = false;
 
-        const intptr_t balance = ((intptr_t)rh) - ((intptr_t)lh);
+    return freed;
+}
 
-        if (balance >= -1 && balance <= 1)
-            continue;
+// Sweep young objects in a chunk after a minor collection, promote the
+// survivors. Return number of freed objects
+static size_t chunk_sweep_young(Chunk* chunk) {
+    size_t freed = 0;
 
-        Object** slot = object_slot(root, p);
+    for (size_t w = 0; w < chunk->words; ++w) {
+        const uint64_t young = chunk->live_bits[w] & ~chunk->old_bits[w];
+        uint64_t dead = young & ~chunk->mark_bits[w];
 
-        if (balance < -1) { // Left cases
-            if (obj < p->left) { // Left left
-                *slot = object_rotate_right(p);
-            } else { // Left right
-                p->left = object_rotate_left(p->left);
-                *slot = object_rotate_right(p);
-            }
-        } else { // Right cases
-            if (obj > p->right) { // Right right
-                *slot = object_rotate_left(p);
-            } else { // Right left
-                p->right = object_rotate_right(p->right);
-                *slot = object_rotate_left(p);
-            }
-        }
+        chunk->live_bits[w] &= ~dead;
+        chunk->old_bits[w] |= young & chunk->mark_bits[w];
 
-        // Balancing one node is enough on insertion,
-        // its height will be unchanged
-        break;
+        for (; dead; dead &= dead - 1, ++freed)
+            object_free(chunk, chunk_slot(chunk, w*64 + sm_ctz64(dead)));
     }
+
+    memset(chunk->mark_bits, 0, chunk->words*sizeof(uint64_t));
+
+    chunk->live -= freed;
+
+    return freed;
 }
 
-static void object_erase(Object** root, Object* obj) {
-    // If node has two children, swap it with predecessor
-    if (obj->left && obj->right) {
-        #define SWAP(a, b) { Object* tmp = (a); (a) = (b); (b) = tmp; }
+// Sweep pending chunks until one with free slots turns up. Empty chunks
+// are released, full ones are moved to the full list
+static Chunk* class_sweep_next(SmHeap* heap, SmHeapClass* cls) {
+    while (cls->unswept) {
+        Chunk* chunk = cls->unswept;
+        cls->unswept = chunk->next;
+
+        chunk_sweep(chunk);
+
+        if (!chunk->live) {
+            chunk_free(heap, chunk);
+        } else if (chunk_full(chunk)) {
+            chunk->next = cls->full;
+            cls->full = chunk;
+        } else {
+            return chunk;
+        }
+    }
+
+    return NULL;
+}
 
-        Object* pred = obj->left;
-        while (pred->right)
-            pred = pred->right;
+// Finish the lazy sweep of a size class
+static void class_sweep_all(SmHeap* heap, SmHeapClass* cls) {
+    for (Chunk* chunk; (chunk = class_sweep_next(heap, cls));) {
+        chunk->next = cls->available;
+        cls->available = chunk;
+    }
+}
 
-        SWAP(obj->parent, pred->parent);
-        SWAP(obj->left, pred->left);
-        SWAP(obj->right, pred->right);
+// Objects are accounted for by their slot size
+static inline void account_alloc(SmHeap* heap, Chunk const* chunk) {
+    ++heap->gc.object_count;
+    heap->gc.bytes += chunk->slot_size;
+    heap->gc.allocated_bytes += chunk->slot_size;
+    heap->gc.young_bytes += chunk->slot_size;
 
-        pred->height = obj->height;
-        pred->lower_bound = obj->lower_bound;
-        pred->upper_bound = obj->upper_bound;
+    ++heap->stats.allocated_objects[chunk->type];
+    heap->stats.allocated_bytes[chunk->type] += chunk->slot_size;
+}
 
-        if (pred->left == pred)
-            pred->left = obj;
-        else
-            obj->parent->right = obj;
+static Object* class_alloc(SmHeap* heap, size_t index, Type type, size_t payload) {
+    SmHeapClass* cls = &heap->classes[index];
+    Chunk* chunk = cls->current;
 
-        pred->left->parent = pred;
-        pred->right->parent = pred;
+    // Retire exhausted chunk, then take one with free slots or make a new one
+    if (!chunk || chunk_full(chunk)) {
+        if (chunk) {
+            chunk->next = cls->nursery;
+            cls->nursery = chunk;
+        }
 
-        if (!pred->parent)
-            *root = pred;
-        else if (obj == pred->parent->left)
-            pred->parent->left = pred;
-        else
-            pred->parent->right = pred;
+        if (cls->available) {
+            chunk = cls->available;
+            cls->available = chunk->next;
+        } else if (!(chunk = class_sweep_next(heap, cls))) {
+            const size_t size = slot_size(payload);
+            chunk = chunk_new(heap, type, size, chunk_capacity(size));
+        }
 
-        #undef SWAP
+        chunk->next = NULL;
+        cls->current = chunk;
     }
 
-    // Replace node with (possibly non-NULL) child
-    Object* child = obj->left ? obj->left : obj->right;
+    // Pop free list first, bump allocate otherwise
+    Object* obj = chunk->free;
+    if (obj)
+        chunk->free = obj->data.next;
+    else
+        obj = chunk_slot(chunk, chunk->top++);
 
-    if (child)
-        child->parent = obj->parent;
+    bit_set(chunk->live_bits, (((uint8_t*) obj) - chunk->slots)/chunk->slot_size);
+    ++chunk->live;
+    object_init(obj, type);
 
-    *object_slot(root, obj) = child;
+    account_alloc(heap, chunk);
 
-    // Rebalance AVL tree
-    for (Object* p = obj->parent; p; p = p->parent) {
-        const size_t lh = p->left ? p->left->height : 0;
-        const size_t rh = p->right ? p->right->height : 0;
-        p->height = 1 + ((lh < rh) ? rh : lh);
+    return obj;
+}
 
-        // Update bounds
-        p->lower_bound = p->left ? p->left->lower_bound : ((uintptr_t) p);
-        p->upper_bound = p->right ? p->right->upper_bound : p->end;
+static Object* large_alloc(SmHeap* heap, size_t payload) {
+    SmHeapClass* cls = &heap->classes[ClassLarge];
 
-        const intptr_t balance = ((intptr_t)rh) - ((intptr_t)lh);
+    // Release dead large strings before asking for more memory
+    class_sweep_all(heap, cls);
 
-        if (balance >= -1 && balance <= 1)
-            continue;
+    // Large strings get a chunk of their own
+    Chunk* chunk = chunk_new(heap, String, slot_size(payload), 1);
 
-        Object** slot = object_slot(root, p);
+    chunk->next = cls->nursery;
+    cls->nursery = chunk;
 
-        if (balance < -1) { // Left cases
-            if (!p->right || p->left->height >= p->right->height) { // Left left
-                *slot = object_rotate_right(p);
-            } else { // Left right
-                p->left = object_rotate_left(p->left);
-                *slot = object_rotate_right(p);
-            }
-        } else { // Right cases
-            if (!p->left || p->right->height >= p->left->height) { // Right right
-                *slot = object_rotate_left(p);
-            } else { // Right left
-                p->right = object_rotate_right(p->right);
-                *slot = object_rotate_left(p);
-            }
-        }
+    Object* obj = chunk_slot(chunk, chunk->top++);
+
+    bit_set(chunk->live_bits, 0);
+    ++chunk->live;
+    object_init(obj, String);
+
+    account_alloc(heap, chunk);
+
+    return obj;
+}
+
+static void class_drop(SmHeapClass* cls) {
+    Chunk* lists[] = { cls->current, cls->available, cls->full, cls->nursery, cls->unswept };
+
+    for (size_t l = 0; l < sizeof(lists)/sizeof(lists[0]); ++l) {
+        for (Chunk *chunk = lists[l], *next; chunk; chunk = next) {
+            next = chunk->next;
 
-        // On deletion, we go up the tree and rebalance all nodes
-        p = *slot;
+            // Drop everything still allocated, dead or alive
+            for (size_t w = 0; w < chunk->words; ++w)
+                for (uint64_t live = chunk->live_bits[w]; live; live &= live - 1)
+                    object_drop(chunk->type, chunk_slot(chunk, w*64 + sm_ctz64(live)));
+
+            free(chunk->base);
+        }
     }
+
+    *cls = (SmHeapClass){ NULL, NULL, NULL, NULL, NULL };
 }
 
-static Object* object_from_pointer(Object* root, void const* ptr, bool find) {
-    Object* obj = root;
-    const uintptr_t key = (uintptr_t) ptr;
+static inline Root* root_from_pointer(bool value, void const* ptr) {
+    return (Root*) (((uint8_t*) ptr) - offsetof(Root, ref) -
+        (value ? offsetof(union Ref, value) : offsetof(union Ref, any)));
+}
 
-    if (!ptr)
-        return NULL;
+static Root* root_push(SmHeapRootStack* stack, RootKind kind) {
+    RootBlock* top = stack->top;
 
-    // Tree lookup for an object containing this pointer
-    while (obj) {
-        if ((obj->all_marked && !find) || key < obj->lower_bound || key >= obj->upper_bound)
-            return NULL;
+    if (!top || top->top == ROOT_BLOCK_SIZE) {
+        if (stack->spare) {
+            top = stack->spare;
+            stack->spare = NULL;
+        } else {
+            top = malloc(sizeof(RootBlock));
+            sm_guard(top != NULL, "allocation failed");
+        }
 
-        if (key < ((uintptr_t) obj))
-            obj = obj->left;
-        else if (key < obj->end)
-            return obj;
-        else
-            obj = obj->right;
+        top->prev = stack->top;
+        top->top = 0;
+        stack->top = top;
     }
 
-    return obj;
+    Root* r = &top->slots[top->top++];
+    r->kind = kind;
+
+    return r;
 }
 
-static Object* object_first(Object* root) {
-    if (!root)
-        return NULL;
+// Roots are usually dropped in LIFO order. Others become tombstones that
+// are reclaimed once everything above them is gone
+static void root_pop(SmHeapRootStack* stack, Root* r) {
+    r->kind = RootDead;
 
-    while (root->left)
-        root = root->left;
+    for (RootBlock* top = stack->top; top; top = stack->top) {
+        while (top->top && top->slots[top->top - 1].kind == RootDead)
+            --top->top;
 
-    return root;
+        if (top->top)
+            break;
+
+        stack->top = top->prev;
+        free(stack->spare);
+        stack->spare = top;
+    }
 }
 
-// Traverse tree depth first
-// XXX: NOT IN ORDER, SUITABLE FOR DROPPING THE WHOLE TREE
-static Object* object_next(Object* obj) {
-    if (!obj || !obj->parent)
-        return NULL;
+// Marking state
+typedef struct Marker {
+    SmHeap* heap;
+    bool minor;     // Stop at old objects
+    size_t count;   // Objects marked so far
+    size_t bytes;   // Bytes marked so far
+    size_t edges;   // References followed so far
+    size_t roots;   // Roots scanned so far
+} Marker;
+
+static void mark_push(SmHeapMarkStack* stack, Object* obj, Type type) {
+    MarkSegment* top = stack->top;
+
+    if (!top || top->size == SM_HEAP_MARK_SEGMENT) {
+        if (stack->spare) {
+            top = stack->spare;
+            stack->spare = NULL;
+        } else {
+            top = malloc(sizeof(MarkSegment));
+            sm_guard(top != NULL, "allocation failed");
+        }
+
+        top->prev = stack->top;
+        top->size = 0;
+        stack->top = top;
+    }
 
-    if (obj == obj->parent->left) {
-        obj = obj->parent;
-        while (obj->right)
-            obj = object_first(obj->right);
+    top->items[top->size++] = (struct Grey){ obj, type };
+}
 
-        return obj;
+static bool mark_pop(SmHeapMarkStack* stack, struct Grey* grey) {
+    MarkSegment* top = stack->top;
+
+    while (top && !top->size) {
+        // Keep one segment around for the next collection
+        stack->top = top->prev;
+        free(stack->spare);
+        stack->spare = top;
+        top = stack->top;
     }
 
-    return obj->parent;
+    if (!top)
+        return false;
+
+    *grey = top->items[--top->size];
+    return true;
 }
 
-// Traverse tree in order
-// XXX: IN SORTED ORDER, SUITABLE FOR DROPPING SINGLE NODES
-static Object* object_succ(Object* obj) {
-    if (!obj)
+// Mark an object if it is managed and not marked yet. Return it for
+// tracing, or NULL when there is nothing to do
+static Object* gc_shade(Marker* m, void const* ptr, Type* type) {
+    ++m->edges;
+
+    Chunk* chunk = chunk_from_pointer(&m->heap->pages, ptr);
+    const size_t index = chunk ? slot_from_pointer(chunk, ptr) : 0;
+
+    if (!chunk || index == chunk->capacity || bit_test(chunk->mark_bits, index))
         return NULL;
 
-    if (obj->right)
-        return object_first(obj->right);
+    if (m->minor && object_is_old(chunk, index))
+        return NULL;
 
-    while (obj->parent && obj == obj->parent->right)
-        obj = obj->parent;
+    bit_set(chunk->mark_bits, index);
+    ++m->count;
+    m->bytes += chunk->slot_size;
 
-    return obj->parent;
+    *type = chunk->type;
+    return chunk_slot(chunk, index);
 }
 
-static inline Root* root_from_pointer(bool value, void const* ptr) {
-    return (Root*) (((uint8_t*) ptr) - offsetof(Root, ref) -
-        (value ? offsetof(union Ref, value) : offsetof(union Ref, any)));
-}
+// Mark an object and queue it for tracing
+static void gc_mark(Marker* m, void const* ptr) {
+    Type type;
+    Object* obj = gc_shade(m, ptr, &type);
 
-static void gc_mark(Object* root, Object* obj);
+    if (obj)
+        mark_push(&m->heap->marks, obj, type);
+}
 
-static void gc_mark_value(Object* root, SmValue value) {
+static void gc_mark_value(Marker* m, SmValue value) {
     switch (value.type) {
         case SmTypeSymbol:
-            gc_mark(root, object_from_pointer(root, value.data.symbol, false));
+            gc_mark(m, value.data.symbol);
             break;
         case SmTypeString:
-            gc_mark(root, object_from_pointer(root, value.data.string.data, false));
+            gc_mark(m, value.data.string);
             break;
         case SmTypeCons:
-            gc_mark(root, object_from_pointer(root, value.data.cons, false));
+            gc_mark(m, value.data.cons);
             break;
         case SmTypeFunction:
-            gc_mark(root, object_from_pointer(root, value.data.function, false));
+            gc_mark(m, value.data.function);
             break;
         default:
             break;
     }
 }
 
-static void gc_mark(Object* root, Object* obj) {
-    while (obj && !obj->marked) {
-        // Mark object and ancestors if needed
-        obj->marked = true;
-        obj->all_marked = (!obj->left || obj->left->all_marked) &&
-                          (!obj->right || obj->right->all_marked);
-
-        if (obj->all_marked) {
-            for (Object* p = obj->parent; p; p = p->parent) {
-                p->all_marked = p->marked &&
-                                (!p->left || p->left->all_marked) &&
-                                (!p->right || p->right->all_marked);
-                if (!p->all_marked)
-                    break;
-            }
-        }
+// Mark all references held by an object but one, which is returned so
+// that callers can follow it without going through the mark stack
+static void const* gc_trace(Marker* m, Type type, Object* obj) {
+    switch (type) {
+        case Symbol:
+            return obj->data.symbol.str.data;
+
+        case Cons:
+            gc_mark_value(m, obj->data.cons.car);
+
+            if (sm_value_is_cons(obj->data.cons.cdr))
+                return obj->data.cons.cdr.data.cons;
+
+            gc_mark_value(m, obj->data.cons.cdr);
+            return NULL;
+
+        case Scope:
+            for (SmVariable* var = sm_scope_first(&obj->data.scope); var; var = sm_scope_next(&obj->data.scope, var))
+                gc_mark_value(m, var->value);
+
+            return obj->data.scope.parent;
+
+        case Function:
+            gc_mark(m, obj->data.function.capture);
+
+            for (size_t i = 0; i < obj->data.function.code.constant_count; ++i)
+                gc_mark_value(m, obj->data.function.code.constants[i]);
 
-        switch (obj->type) {
-            case Symbol:
-                obj = object_from_pointer(root, obj->data.symbol.data, false);
-                break;
+            return obj->data.function.progn;
 
-            case Cons:
-                gc_mark_value(root, obj->data.cons.car);
+        default:
+            return NULL;
+    }
+}
 
-                if (sm_value_is_cons(obj->data.cons.cdr))
-                    obj = object_from_pointer(root, obj->data.cons.cdr.data.cons, false);
-                else
-                    gc_mark_value(root, obj->data.cons.cdr);
+// Trace grey objects until the mark stack is empty. Native stack usage
+// does not depend on the shape of the heap
+static void gc_drain(Marker* m) {
+    struct Grey grey;
 
-                break;
+    while (mark_pop(&m->heap->marks, &grey)) {
+        Object* obj = grey.obj;
+        Type type = grey.type;
 
-            case Scope:
-                for (SmVariable* var = sm_scope_first(&obj->data.scope); var; var = sm_scope_next(&obj->data.scope, var))
-                    gc_mark_value(root, var->value);
+        do {
+            void const* next = gc_trace(m, type, obj);
+            obj = next ? gc_shade(m, next, &type) : NULL;
+        } while (obj);
+    }
+}
 
-                obj = object_from_pointer(root, obj->data.scope.parent, false);
-                break;
+static void gc_mark_roots(Marker* m, SmContext const* ctx) {
+    for (RootBlock* block = m->heap->roots.top; block; block = block->prev) {
+        m->roots += block->top;
 
-            case Function:
-                gc_mark(root, object_from_pointer(root, obj->data.function.capture, false));
-                obj = object_from_pointer(root, obj->data.function.progn, false);
-                break;
+        for (size_t i = 0; i < block->top; ++i) {
+            Root* r = &block->slots[i];
 
-            default:
-                break;
+            if (r->kind == RootValue)
+                gc_mark_value(m, r->ref.value);
+            else if (r->kind == RootPointer)
+                gc_mark(m, r->ref.any);
         }
     }
+
+    for (SmHeapRootFrame* frame = m->heap->roots.frames; frame; frame = frame->parent) {
+        m->roots += frame->count;
+
+        for (size_t i = 0; i < frame->count; ++i)
+            gc_mark_value(m, frame->values[i]);
+    }
+
+    if (ctx) {
+        // Ensure current and global scope are marked
+        gc_mark(m, ctx->scope);
+        ++m->roots;
+
+        for (SmVariable* var = sm_scope_first(&ctx->globals); var; var = sm_scope_next(&ctx->globals, var)) {
+            gc_mark_value(m, var->value);
+            ++m->roots;
+        }
+
+        // Walk stack and mark live scopes
+        for (SmStackFrame* frame = ctx->frame; frame; frame = frame->parent) {
+            gc_mark(m, frame->saved_scope);
+            ++m->roots;
+        }
+    }
+}
+
+// Empty the remembered set. When tracing, mark whatever remembered objects
+// reference
+static void gc_forget(Marker* m, bool trace) {
+    SmHeapRememberedSet* set = &m->heap->remembered;
+
+    for (size_t i = 0; i < set->size; ++i) {
+        Chunk* chunk = chunk_from_pointer(&m->heap->pages, set->objects[i]);
+        const size_t index = (((uint8_t const*) set->objects[i]) - chunk->slots)/chunk->slot_size;
+
+        bit_clear(chunk->remembered_bits, index);
+
+        if (trace)
+            gc_mark(m, gc_trace(m, chunk->type, chunk_slot(chunk, index)));
+    }
+
+    set->size = 0;
+}
+
+// Let the heap grow proportionally to live data before the next full
+// collection, but never below the configured minimum
+static void gc_update_threshold(struct SmGCStatus* gc) {
+    const double threshold = (double) gc->live_bytes*gc->config.heap_growth;
+
+    gc->threshold = (threshold >= (double) SIZE_MAX) ? SIZE_MAX : (size_t) threshold;
+    if (gc->threshold < gc->config.heap_min)
+        gc->threshold = gc->config.heap_min;
+}
+
+// Record a finished collection and report it
+static void gc_report(SmHeap* heap, Marker const* m, uint64_t start, size_t freed, size_t freed_bytes) {
+    SmGCStats* stats = &heap->stats;
+    const uint64_t pause = sm_clock_ns() - start;
+
+    size_t bucket = 0;
+    while (bucket < SM_GC_PAUSE_BUCKETS - 1 && (pause >> (bucket + 1)))
+        ++bucket;
+
+    if (m->minor)
+        ++stats->minor_collections;
+    else
+        ++stats->collections;
+
+    stats->pause_total_ns += pause;
+    if (pause > stats->pause_max_ns)
+        stats->pause_max_ns = pause;
+    ++stats->pauses[bucket];
+
+    stats->freed_objects += freed;
+    stats->freed_bytes += freed_bytes;
+    stats->marked_objects += m->count;
+    stats->marked_edges += m->edges;
+    stats->roots_scanned += m->roots;
+
+    if (heap->hook.fn) {
+        const SmGCEvent event = { m->minor, pause, m->count, m->edges, m->roots, freed, freed_bytes };
+        heap->hook.fn(heap, &event, heap->hook.data);
+    }
 }
 
 // Heap functions
 void sm_heap_drop(SmHeap* heap) {
-    for (Object *obj = object_first(heap->objects), *next; obj; obj = next) {
-        next = object_next(obj);
-        object_drop(obj);
-    }
+    for (size_t i = 0; i < SM_HEAP_CLASS_COUNT; ++i)
+        class_drop(&heap->classes[i]);
 
-    for (Root *r = heap->roots, *next; r; r = next) {
-        next = r->next;
-        free(r);
+    for (RootBlock *block = heap->roots.top, *prev; block; block = prev) {
+        prev = block->prev;
+        free(block);
     }
 
-    heap->objects = NULL;
-    heap->roots = NULL;
+    free(heap->roots.spare);
+
+    free(heap->pages.entries);
+    heap->pages = (SmHeapPageTable){ NULL, 0, 0 };
+
+    free(heap->remembered.objects);
+    heap->remembered = (SmHeapRememberedSet){ NULL, 0, 0 };
+
+    // The mark stack is empty between collections
+    free(heap->marks.spare);
+    heap->marks = (SmHeapMarkStack){ NULL, NULL };
+
+    heap->roots = (SmHeapRootStack){ NULL, NULL, NULL };
 
     // Reset gc status
-    heap->gc.object_count = heap->gc.unref_count = 0;
-    heap->gc.object_threshold = heap->gc.config.object_threshold;
+    heap->gc.object_count = heap->gc.bytes = heap->gc.live_bytes = 0;
+    heap->gc.allocated_bytes = heap->gc.young_bytes = 0;
+    heap->gc.threshold = heap->gc.config.heap_min;
+    heap->stats = (SmGCStats){ 0 };
 }
 
 bool sm_heap_is_managed(SmHeap const* heap, void const* ptr) {
-    return object_from_pointer(heap->objects, ptr, true) != NULL;
+    Chunk* chunk = chunk_from_pointer(&heap->pages, ptr);
+    return chunk && slot_from_pointer(chunk, ptr) != chunk->capacity;
 }
 
 SmSymbol sm_heap_alloc_symbol(SmHeap* heap, SmContext const* ctx) {
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
+    collect_if_needed(heap, ctx);
 
-    Object* obj = object_new(Symbol, 0);
-    object_insert(&heap->objects, obj);
-
-    ++heap->gc.object_count;
+    Object* obj = class_alloc(heap, ClassSymbol, Symbol, sizeof(SmSymbolHeader));
 
-    return &obj->data.cons;
+    return &obj->data.symbol;
 }
 
 SmCons* sm_heap_alloc_cons(SmHeap* heap, SmContext const* ctx) {
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
-
-    Object* obj = object_new(Cons, 0);
-    object_insert(&heap->objects, obj);
+    collect_if_needed(heap, ctx);
 
-    ++heap->gc.object_count;
+    Object* obj = class_alloc(heap, ClassCons, Cons, sizeof(SmCons));
 
     return &obj->data.cons;
 }
 
 SmScope* sm_heap_alloc_scope(SmHeap* heap, SmContext const* ctx) {
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
+    collect_if_needed(heap, ctx);
 
-    Object* obj = object_new(Scope, 0);
-    object_insert(&heap->objects, obj);
-
-    ++heap->gc.object_count;
+    Object* obj = class_alloc(heap, ClassScope, Scope, sizeof(SmScope));
 
     return &obj->data.scope;
 }
 
 SmFunction* sm_heap_alloc_function(SmHeap* heap, SmContext const* ctx) {
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
-
-    Object* obj = object_new(Function, 0);
-    object_insert(&heap->objects, obj);
+    collect_if_needed(heap, ctx);
 
-    ++heap->gc.object_count;
+    Object* obj = class_alloc(heap, ClassFunction, Function, sizeof(SmFunction));
 
     return &obj->data.function;
 }
 
 char* sm_heap_alloc_string(SmHeap* heap, SmContext const* ctx, size_t length) {
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
+    collect_if_needed(heap, ctx);
 
-    Object* obj = object_new(String, sizeof(char)*length);
-    object_insert(&heap->objects, obj);
+    const size_t index = string_class(length);
 
-    ++heap->gc.object_count;
+    // Slots are sized for the largest string in their class
+    Object* obj = (length > STRING_CLASS_MAX) ?
+        large_alloc(heap, sizeof(char)*length) :
+        class_alloc(heap, index, String, sizeof(char)*string_class_size(index));
 
     return &obj->data.string;
 }
 
-void** sm_heap_root(SmHeap* heap) {
-    Root* r = sm_aligned_alloc(sm_alignof(Root), sizeof(Root));
+SmStringHeader const* sm_heap_alloc_string_value(SmHeap* heap, SmContext const* ctx, SmString str) {
+    // Characters follow the header in the same slot
+    SmStringHeader* string = (SmStringHeader*) sm_heap_alloc_string(heap, ctx, sizeof(SmStringHeader) + str.length);
+    char* data = (char*) (string + 1);
 
-    *r = (Root){ heap->roots, NULL, false, { .any = NULL } };
+    if (str.length > 0)
+        memcpy(data, str.data, str.length*sizeof(char));
 
-    if (heap->roots)
-        heap->roots->prev = r;
+    *string = (SmStringHeader){ { data, str.length }, sm_hash_str((SmString){ data, str.length }, 0) };
+    return string;
+}
 
-    heap->roots = r;
+void** sm_heap_root(SmHeap* heap) {
+    Root* r = root_push(&heap->roots, RootPointer);
+    r->ref.any = NULL;
 
     return &r->ref.any;
 }
 
 SmValue* sm_heap_root_value(SmHeap* heap) {
-    Root* r = sm_aligned_alloc(sm_alignof(Root), sizeof(Root));
+    Root* r = root_push(&heap->roots, RootValue);
+    r->ref.value = sm_value_nil();
+
+    return &r->ref.value;
+}
+
+void sm_heap_root_drop(SmHeap* heap, SmContext const* ctx, void** root) {
+    sm_unused(ctx);
+    root_pop(&heap->roots, root_from_pointer(false, root));
+}
+
+void sm_heap_root_value_drop(SmHeap* heap, SmContext const* ctx, SmValue* root) {
+    sm_unused(ctx);
+    root_pop(&heap->roots, root_from_pointer(true, root));
+}
 
-    *r = (Root){ heap->roots, NULL, true, { .value = sm_value_nil() } };
+void sm_heap_write_barrier(SmHeap* heap, void const* ptr) {
+    // Without minor collections every collection traces the whole heap
+    if (!heap->gc.config.nursery_size)
+        return;
 
-    if (heap->roots)
-        heap->roots->prev = r;
+    Chunk* chunk = chunk_from_pointer(&heap->pages, ptr);
+    const size_t index = chunk ? slot_from_pointer(chunk, ptr) : 0;
 
-    heap->roots = r;
+    if (!chunk || index == chunk->capacity || !object_is_old(chunk, index) ||
+        bit_test(chunk->remembered_bits, index))
+    {
+        return;
+    }
 
-    return &r->ref.value;
+    SmHeapRememberedSet* set = &heap->remembered;
+    if (set->size == set->capacity) {
+        set->capacity = set->capacity ? 2*set->capacity : 64;
+        set->objects = realloc(set->objects, set->capacity*sizeof(void const*));
+        sm_guard(set->objects != NULL, "allocation failed");
+    }
+
+    bit_set(chunk->remembered_bits, index);
+    set->objects[set->size++] = chunk_slot(chunk, index);
 }
 
-void sm_heap_root_drop(SmHeap* heap, SmContext const* ctx, void** root) {
-    Root* r = root_from_pointer(false, root);
+uint64_t sm_gc_stats_pause_percentile(SmGCStats const* stats, double fraction) {
+    size_t total = 0;
+    for (size_t i = 0; i < SM_GC_PAUSE_BUCKETS; ++i)
+        total += stats->pauses[i];
 
-    if (r->prev)
-        r->prev->next = r->next;
-    else
-        heap->roots = r->next;
+    if (!total)
+        return 0;
 
-    if (r->next)
-        r->next->prev = r->prev;
+    // Walk buckets until enough collections are covered
+    const double target = fraction*(double) total;
+    size_t seen = 0;
 
-    if (r->ref.any) {
-        Object* obj = object_from_pointer(heap->objects, r->ref.any, true);
-        if (obj) {
-            ++heap->gc.unref_count;
-            if (obj->type == Scope)
-                heap->gc.unref_count += (obj->data.scope.parent != NULL) + sm_scope_size(&obj->data.scope);
+    for (size_t i = 0; i < SM_GC_PAUSE_BUCKETS - 1; ++i) {
+        seen += stats->pauses[i];
+
+        if ((double) seen >= target) {
+            const uint64_t bound = (UINT64_C(2) << i) - 1;
+            return (bound < stats->pause_max_ns) ? bound : stats->pause_max_ns;
         }
     }
 
-    free(r);
-
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
+    return stats->pause_max_ns;
 }
 
-void sm_heap_root_value_drop(SmHeap* heap, SmContext const* ctx, SmValue* root) {
-    Root* r = root_from_pointer(true, root);
+void sm_heap_gc(SmHeap* heap, SmContext const* ctx) {
+    const uint64_t start = sm_clock_ns();
 
-    if (r->prev)
-        r->prev->next = r->next;
-    else
-        heap->roots = r->next;
+    // Finish sweeping after the previous collection, so all marks are clear
+    for (size_t i = 0; i < SM_HEAP_CLASS_COUNT; ++i)
+        class_sweep_all(heap, &heap->classes[i]);
 
-    if (r->next)
-        r->next->prev = r->prev;
+    // Mark phase: the whole heap is traced, remembered objects included
+    Marker m = { heap, false, 0, 0, 0, 0 };
 
-    if (sm_value_is_symbol(r->ref.value) ||
-        sm_value_is_string(r->ref.value) ||
-        sm_value_is_cons(r->ref.value) ||
-        sm_value_is_function(r->ref.value))
-    {
-        ++heap->gc.unref_count;
+    gc_forget(&m, false);
+    gc_mark_roots(&m, ctx);
+    gc_drain(&m);
+
+    // Sweep phase is lazy: queue all chunks, the allocator sweeps them
+    // on demand and the next collection finishes the job
+    for (size_t i = 0; i < SM_HEAP_CLASS_COUNT; ++i) {
+        SmHeapClass* cls = &heap->classes[i];
+        Chunk* lists[] = { cls->current, cls->available, cls->full, cls->nursery };
+
+        *cls = (SmHeapClass){ NULL, NULL, NULL, NULL, NULL };
+
+        for (size_t l = 0; l < sizeof(lists)/sizeof(lists[0]); ++l) {
+            for (Chunk *chunk = lists[l], *next; chunk; chunk = next) {
+                next = chunk->next;
+
+                chunk->unswept = true;
+                chunk->next = cls->unswept;
+                cls->unswept = chunk;
+            }
+        }
     }
 
-    free(r);
+    // Update gc status. Everything unmarked is dead, even if not swept yet
+    const size_t freed = heap->gc.object_count - m.count;
+    const size_t freed_bytes = heap->gc.bytes - m.bytes;
 
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
-}
+    heap->gc.object_count = m.count;
+    heap->gc.bytes = heap->gc.live_bytes = m.bytes;
+    gc_update_threshold(&heap->gc);
 
-void sm_heap_unref(SmHeap* heap, SmContext const* ctx, size_t count) {
-    heap->gc.unref_count += count;
+    heap->gc.allocated_bytes = 0;
+    heap->gc.young_bytes = 0;
 
-    if (should_collect(&heap->gc))
-        sm_heap_gc(heap, ctx);
+    gc_report(heap, &m, start, freed, freed_bytes);
 }
 
-void sm_heap_gc(SmHeap* heap, SmContext const* ctx) {
-    // Mark phase
-
-    // Mark roots
-    for (Root* r = heap->roots; r; r = r->next) {
-        if (r->value)
-            gc_mark_value(heap->objects, r->ref.value);
-        else
-            gc_mark(heap->objects, object_from_pointer(heap->objects, r->ref.any, false));
+void sm_heap_gc_minor(SmHeap* heap, SmContext const* ctx) {
+    // Old objects are not remembered: only a full trace finds what they hold
+    if (!heap->gc.config.nursery_size) {
+        sm_heap_gc(heap, ctx);
+        return;
     }
 
-    if (ctx) {
-        // Ensure current and global scope are marked
-        gc_mark(heap->objects, object_from_pointer(heap->objects, ctx->scope, false));
+    const uint64_t start = sm_clock_ns();
 
-        for (SmVariable* var = sm_scope_first(&ctx->globals); var; var = sm_scope_next(&ctx->globals, var))
-            gc_mark_value(heap->objects, var->value);
+    // Mark phase: trace young objects from roots and remembered objects
+    Marker m = { heap, true, 0, 0, 0, 0 };
 
-        // Walk stack and mark live scopes
-        for (SmStackFrame* frame = ctx->frame; frame; frame = frame->parent)
-            gc_mark(heap->objects, object_from_pointer(heap->objects, frame->saved_scope, false));
-    }
+    gc_mark_roots(&m, ctx);
+    gc_forget(&m, true);
+    gc_drain(&m);
 
-    // Sweep phase
-    for (Object *obj = object_first(heap->objects), *next; obj; obj = next) {
-        next = object_succ(obj);
+    // Sweep phase: only chunks allocated from since the last collection
+    // may hold young objects
+    size_t freed = 0, freed_bytes = 0;
 
-        if (!obj->marked) {
-            object_erase(&heap->objects, obj);
-            object_drop(obj);
-            --heap->gc.object_count;
-        } else {
-            obj->marked = false;
-            obj->all_marked = false;
+    for (size_t i = 0; i < SM_HEAP_CLASS_COUNT; ++i) {
+        SmHeapClass* cls = &heap->classes[i];
+
+        if (cls->current) {
+            const size_t count = chunk_sweep_young(cls->current);
+            freed += count;
+            freed_bytes += count*cls->current->slot_size;
         }
-    }
 
-    // Update gc status
-    if (heap->gc.object_count >= heap->gc.object_threshold)
-    {
-        heap->gc.object_threshold *= heap->gc.config.object_threshold_factor;
-    }
-    else if (heap->gc.object_threshold > heap->gc.config.object_threshold &&
-             heap->gc.object_count < (heap->gc.object_threshold/heap->gc.config.object_threshold_factor))
-    {
-        heap->gc.object_threshold /= heap->gc.config.object_threshold_factor;
+        Chunk* nursery = cls->nursery;
+        cls->nursery = NULL;
+
+        for (Chunk *chunk = nursery, *next; chunk; chunk = next) {
+            next = chunk->next;
+
+            const size_t count = chunk_sweep_young(chunk);
+            freed += count;
+            freed_bytes += count*chunk->slot_size;
+
+            if (!chunk->live) {
+                chunk_free(heap, chunk);
+            } else if (chunk_full(chunk)) {
+                chunk->next = cls->full;
+                cls->full = chunk;
+            } else {
+                chunk->next = cls->available;
+                cls->available = chunk;
+            }
+        }
     }
 
-    heap->gc.unref_count = 0;
+    // Update gc status, a full collection follows if the old generation
+    // outgrew the threshold
+    heap->gc.object_count -= freed;
+    heap->gc.bytes -= freed_bytes;
+
+    heap->gc.young_bytes = 0;
+
+    gc_report(heap, &m, start, freed, freed_bytes);
 }
@@ -0,0 +1,75 @@
+#include "context.h"
+#include "heap.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Build a complete binary tree of conses with the given number of nodes
+// into a reachable location
+static void build_tree(SmHeap* heap, SmContext const* ctx, size_t nodes, SmValue* out) {
+    if (!nodes) {
+        *out = sm_value_nil();
+        return;
+    }
+
+    const size_t left = (nodes - 1)/2;
+
+    SmCons* cons = sm_heap_alloc_cons(heap, ctx);
+    *out = sm_value_cons(cons);
+
+    build_tree(heap, ctx, left, &cons->car);
+    build_tree(heap, ctx, nodes - 1 - left, &cons->cdr);
+}
+
+// Build a chain of conses nested through car
+static void build_chain(SmHeap* heap, SmContext const* ctx, size_t nodes, SmValue* out) {
+    *out = sm_value_nil();
+
+    for (size_t i = 0; i < nodes; ++i) {
+        SmCons* cons = sm_heap_alloc_cons(heap, ctx);
+        cons->car = *out;
+        *out = sm_value_cons(cons);
+    }
+}
+
+static double bench_gc(SmHeap* heap, SmContext const* ctx, size_t rounds) {
+    double best = 0;
+
+    for (size_t i = 0; i < rounds; ++i) {
+        const clock_t start = clock();
+        sm_heap_gc(heap, ctx);
+        const double elapsed = ((double) (clock() - start))/CLOCKS_PER_SEC;
+
+        if (!i || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t nodes = (argc > 1) ? (size_t) strtoull(argv[1], NULL, 10) : 10000000;
+    const size_t rounds = (argc > 2) ? (size_t) strtoull(argv[2], NULL, 10) : 5;
+
+    // Keep the collector out of the way: collections are triggered
+    // explicitly. Without minor collections no write barriers are needed
+    SmContext* ctx = sm_context((SmGCConfig){ (size_t) -1, 1.0, 0 });
+    SmHeap* heap = &ctx->heap;
+
+    SmValue* root = sm_heap_root_value(heap);
+
+    build_tree(heap, ctx, nodes, root);
+    double elapsed = bench_gc(heap, ctx, rounds);
+    printf("mark tree:  %zu objects, best of %zu: %.3f s\n", sm_heap_size(heap), rounds, elapsed);
+
+    build_chain(heap, ctx, nodes, root);
+    elapsed = bench_gc(heap, ctx, rounds);
+    printf("mark chain: %zu objects, best of %zu: %.3f s\n", sm_heap_size(heap), rounds, elapsed);
+
+    sm_heap_root_value_drop(heap, ctx, root);
+    sm_context_drop(ctx);
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "context.h"
+#include "heap.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static void count_collections(SmHeap const* heap, SmGCEvent const* event, void* data) {
+    sm_unused(heap);
+    size_t* counts = (size_t*) data;
+    ++counts[event->minor];
+}
+
+int main(int argc, char* argv[]) {
+    SmTestContext ctx = sm_test_context(argc, argv);
+
+    // Keep the collector out of the way: tests trigger it explicitly. Minor
+    // collections are enabled so that write barriers are active
+    SmContext* lisp = sm_context((SmGCConfig){ (size_t) -1, 1.0, (size_t) -1 });
+    SmHeap* heap = &lisp->heap;
+
+    const size_t base = sm_heap_size(heap);
+    const size_t count = 10000;
+
+    int stack_var = 0;
+    sm_test(&ctx, "sm_heap_is_managed should return false for NULL",
+        sm_heap_is_managed(heap, NULL) == false);
+    sm_test(&ctx, "sm_heap_is_managed should return false for stack pointers",
+        sm_heap_is_managed(heap, &stack_var) == false);
+
+    SmValue* list = sm_heap_root_value(heap);
+    *list = sm_value_nil();
+
+    // Build a long list, spanning many chunks
+    bool managed = true;
+    for (size_t i = 0; i < count; ++i) {
+        SmCons* cons = sm_heap_alloc_cons(heap, lisp);
+        managed = sm_heap_is_managed(heap, cons) && managed;
+
+        cons->car = sm_value_number(sm_number_int((int64_t) i));
+        cons->cdr = *list;
+        *list = sm_value_cons(cons);
+    }
+
+    sm_test(&ctx, "sm_heap_is_managed should return true for allocated conses", managed);
+    sm_test(&ctx, "sm_heap_size should count allocated conses",
+        sm_heap_size(heap) == base + count);
+
+    // Allocate garbage of every class
+    bool strings_ok = true;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = (i*37) % 5000;
+        char* str = sm_heap_alloc_string(heap, lisp, length);
+        memset(str, 'x', length);
+        strings_ok = sm_heap_is_managed(heap, str) && strings_ok;
+
+        sm_heap_alloc_symbol(heap, lisp);
+        sm_heap_alloc_scope(heap, lisp);
+        sm_heap_alloc_function(heap, lisp);
+    }
+
+    sm_test(&ctx, "sm_heap_is_managed should return true for strings of any length", strings_ok);
+    sm_test(&ctx, "sm_heap_size should count objects of every class",
+        sm_heap_size(heap) == base + 5*count);
+
+    char* large = sm_heap_alloc_string(heap, lisp, 200000);
+    sm_test(&ctx, "sm_heap_is_managed should return true for pointers deep into large strings",
+        sm_heap_is_managed(heap, large + 150000));
+
+    sm_heap_gc(heap, lisp);
+
+    sm_test(&ctx, "sm_heap_gc should free unreachable objects and keep rooted ones",
+        sm_heap_size(heap) == base + count);
+
+    bool list_ok = true;
+    size_t expected = count;
+    for (SmCons* cons = list->data.cons; cons; cons = sm_list_next(cons))
+        list_ok = (sm_value_is_number(cons->car) && cons->car.data.number.value.i == (int64_t) --expected) && list_ok;
+
+    sm_test(&ctx, "rooted list should be intact after sm_heap_gc", list_ok && expected == 0);
+
+    // Freed slots must be reused before the heap grows again
+    SmSymbol reused = sm_heap_alloc_symbol(heap, lisp);
+    sm_test(&ctx, "allocation after sm_heap_gc should return managed memory",
+        sm_heap_is_managed(heap, reused));
+
+    SmCons* garbage = sm_heap_alloc_cons(heap, lisp);
+    sm_heap_gc(heap, lisp);
+    sm_test(&ctx, "sm_heap_is_managed should return false for dead objects awaiting sweep",
+        sm_heap_is_managed(heap, garbage) == false);
+
+    // The list is old now: a young cons stored into it survives minor
+    // collections through the write barrier, young garbage does not
+    const size_t old_size = sm_heap_size(heap);
+    SmCons* young = sm_heap_alloc_cons(heap, lisp);
+    young->car = sm_value_number(sm_number_int(-1));
+    young->cdr = sm_value_nil();
+    list->data.cons->car = sm_value_cons(young);
+    sm_heap_write_barrier(heap, list->data.cons);
+
+    for (size_t i = 0; i < count; ++i)
+        sm_heap_alloc_cons(heap, lisp);
+
+    sm_heap_gc_minor(heap, lisp);
+    sm_test(&ctx, "sm_heap_gc_minor should free young garbage and keep remembered references",
+        sm_heap_size(heap) == old_size + 1 && sm_heap_is_managed(heap, young));
+
+    sm_heap_gc_minor(heap, lisp);
+    sm_test(&ctx, "objects promoted by sm_heap_gc_minor should survive later minor collections",
+        sm_heap_is_managed(heap, young) && young->car.data.number.value.i == -1);
+
+    // Nesting through car must not exhaust the native stack while marking
+    const size_t depth = 1000000;
+    const size_t deep_base = sm_heap_size(heap);
+    SmValue* deep = sm_heap_root_value(heap);
+    *deep = sm_value_nil();
+
+    for (size_t i = 0; i < depth; ++i) {
+        SmCons* cons = sm_heap_alloc_cons(heap, lisp);
+        cons->car = *deep;
+        *deep = sm_value_cons(cons);
+    }
+
+    sm_heap_gc(heap, lisp);
+    sm_test(&ctx, "sm_heap_gc should mark deeply nested structures",
+        sm_heap_size(heap) == deep_base + depth);
+
+    sm_heap_root_value_drop(heap, lisp, deep);
+
+    // Roots dropped out of order must not release the ones above them
+    sm_heap_gc(heap, lisp);
+    const size_t roots_base = sm_heap_size(heap);
+    SmValue* roots[600];
+    for (size_t i = 0; i < 600; ++i) {
+        roots[i] = sm_heap_root_value(heap);
+        *roots[i] = sm_value_cons(sm_heap_alloc_cons(heap, lisp));
+    }
+
+    for (size_t i = 0; i < 600; i += 2)
+        sm_heap_root_value_drop(heap, lisp, roots[i]);
+
+    sm_heap_gc(heap, lisp);
+    sm_test(&ctx, "sm_heap_root_value_drop should only release the dropped root",
+        sm_heap_size(heap) == roots_base + 300);
+
+    for (size_t i = 1; i < 600; i += 2)
+        sm_heap_root_value_drop(heap, lisp, roots[i]);
+
+    // Caller-provided frames root values in place
+    SmValue values[2];
+    SmHeapRootFrame frame;
+    sm_heap_root_frame_push(heap, &frame, values, 2);
+    values[1] = sm_value_cons(sm_heap_alloc_cons(heap, lisp));
+
+    sm_heap_gc(heap, lisp);
+    sm_test(&ctx, "sm_heap_root_frame_push should root the values in the frame",
+        sm_heap_size(heap) == roots_base + 1 && sm_value_is_nil(values[0]));
+
+    sm_heap_root_frame_pop(heap, &frame);
+
+    sm_heap_root_value_drop(heap, lisp, list);
+    sm_heap_gc(heap, lisp);
+
+    sm_test(&ctx, "sm_heap_gc should free objects after their root is dropped",
+        sm_heap_size(heap) == base);
+
+    sm_context_drop(lisp);
+
+    // Full collections are paced by the number of bytes surviving the last one
+    SmContext* paced = sm_context((SmGCConfig){ 4096, 2.0, 0 });
+    heap = &paced->heap;
+
+    size_t collections[2] = { 0, 0 };
+    sm_heap_set_gc_callback(heap, count_collections, collections);
+
+    list = sm_heap_root_value(heap);
+    for (size_t i = 0; i < 1000; ++i) {
+        SmCons* cons = sm_heap_alloc_cons(heap, paced);
+        cons->cdr = *list;
+        *list = sm_value_cons(cons);
+    }
+
+    sm_heap_gc(heap, paced);
+    SmGCPacing pacing = sm_heap_pacing(heap);
+    sm_test(&ctx, "sm_heap_gc should set the threshold to live bytes times the growth factor",
+        pacing.live_bytes >= 1000*sizeof(SmCons) && pacing.threshold == 2*pacing.live_bytes &&
+        pacing.allocated_bytes == 0 && pacing.heap_bytes == pacing.live_bytes);
+
+    bool paced_ok = true;
+    for (size_t i = 0; i < 100*count; ++i) {
+        sm_heap_alloc_cons(heap, paced);
+        pacing = sm_heap_pacing(heap);
+        paced_ok = pacing.heap_bytes <= pacing.threshold + sizeof(SmCons)*2 && paced_ok;
+    }
+
+    sm_test(&ctx, "allocation should trigger collections when the heap reaches the threshold",
+        paced_ok && pacing.live_bytes >= 1000*sizeof(SmCons));
+
+    SmGCStats const* stats = sm_heap_stats(heap);
+    sm_test(&ctx, "sm_heap_stats should count allocations, collections and pauses",
+        stats->allocated_objects[SmHeapObjectCons] == 1000 + 100*count &&
+        stats->allocated_bytes[SmHeapObjectCons] >= stats->allocated_objects[SmHeapObjectCons]*sizeof(SmCons) &&
+        stats->collections > 1 && stats->minor_collections == 0 &&
+        stats->freed_objects >= 100*count - (sm_heap_size(heap) - 1000) &&
+        sm_gc_stats_pause_percentile(stats, 0.5) <= sm_gc_stats_pause_percentile(stats, 0.99) &&
+        sm_gc_stats_pause_percentile(stats, 0.99) <= stats->pause_max_ns);
+
+    sm_test(&ctx, "the gc callback should run once per collection",
+        collections[0] == stats->collections && collections[1] == 0);
+
+    sm_heap_root_value_drop(heap, paced, list);
+    sm_context_drop(paced);
+
+    // Without a nursery write barriers remember nothing, so minor
+    // collections must not trust the remembered set
+    SmContext* full = sm_context((SmGCConfig){ (size_t) -1, 1.0, 0 });
+    heap = &full->heap;
+
+    list = sm_heap_root_value(heap);
+    *list = sm_value_cons(sm_heap_alloc_cons(heap, full));
+    sm_heap_gc(heap, full);
+
+    SmCons* held = sm_heap_alloc_cons(heap, full);
+    held->car = sm_value_number(sm_number_int(-2));
+    held->cdr = sm_value_nil();
+    list->data.cons->car = sm_value_cons(held);
+    sm_heap_write_barrier(heap, list->data.cons);
+
+    sm_heap_gc_minor(heap, full);
+    sm_test(&ctx, "sm_heap_gc_minor should keep young objects held by old ones without a nursery",
+        sm_heap_is_managed(heap, held) && held->car.data.number.value.i == -2 &&
+        sm_heap_stats(heap)->minor_collections == 0);
+
+    sm_heap_root_value_drop(heap, full, list);
+    sm_context_drop(full);
+
+    return !sm_test_report(&ctx);
+}
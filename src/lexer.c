@@ -0,0 +1,242 @@
+#include "private/lexer.h"
+#include "util.h"
+
+#include <stdint.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+    #include <immintrin.h>
+
+    #define LEXER_X86
+    #define LEXER_AVX2 __attribute__((target("avx2,popcnt")))
+#endif
+
+// Scalar scanners, also used for the tails of SIMD scans
+static inline bool is_token_end(char c) {
+    return lexer_is_space(c) || c == '\'' || c == '"' || c == '(' || c == ')' ||
+           c == '`' || c == ',' || c == '|';
+}
+
+static size_t scalar_space(char const* data, size_t length) {
+    size_t i = 0;
+    while (i < length && lexer_is_space(data[i]))
+        ++i;
+
+    return i;
+}
+
+static size_t scalar_token(char const* data, size_t length) {
+    size_t i = 0;
+    while (i < length && !is_token_end(data[i]))
+        ++i;
+
+    return i;
+}
+
+static size_t scalar_string(char const* data, size_t length) {
+    size_t i = 0;
+    while (i < length && data[i] != '"' && data[i] != '\\')
+        ++i;
+
+    return i;
+}
+
+static size_t scalar_newlines(char const* data, size_t length, size_t* last) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] == '\n') {
+            ++count;
+            *last = i;
+        }
+    }
+
+    return count;
+}
+
+static size_t scalar_utf8_starts(char const* data, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i)
+        count += lexer_is_utf8_start(data[i]);
+
+    return count;
+}
+
+#ifdef LEXER_X86
+
+// Masks of the bytes in a block belonging to each class, one bit per byte.
+// Bytes at or above 0x80 are negative as signed chars, so they never fall
+// in the ranges compared against
+static inline uint32_t sse2_space_mask(char const* p) {
+    const __m128i v = _mm_loadu_si128((__m128i const*) p);
+    const __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+}
+
+static inline uint32_t sse2_token_end_mask(char const* p) {
+    const __m128i v = _mm_loadu_si128((__m128i const*) p);
+    __m128i m = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('(')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(')')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('`')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('|')));
+    return (uint32_t) _mm_movemask_epi8(m);
+}
+
+static inline uint32_t sse2_string_end_mask(char const* p) {
+    const __m128i v = _mm_loadu_si128((__m128i const*) p);
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+}
+
+static inline uint32_t sse2_newline_mask(char const* p) {
+    const __m128i v = _mm_loadu_si128((__m128i const*) p);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+// Continuation bytes (0x80-0xbf) and bytes never valid in UTF-8 (0xf8-0xff)
+static inline uint32_t sse2_utf8_other_mask(char const* p) {
+    const __m128i v = _mm_loadu_si128((__m128i const*) p);
+    const __m128i high = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(-9)), _mm_cmplt_epi8(v, _mm_setzero_si128()));
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(-64)), high));
+}
+
+LEXER_AVX2 static inline uint32_t avx2_space_mask(char const* p) {
+    const __m256i v = _mm256_loadu_si256((__m256i const*) p);
+    const __m256i ctl = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+}
+
+LEXER_AVX2 static inline uint32_t avx2_token_end_mask(char const* p) {
+    const __m256i v = _mm256_loadu_si256((__m256i const*) p);
+    __m256i m = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('(')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('`')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')));
+    return (uint32_t) _mm256_movemask_epi8(m);
+}
+
+LEXER_AVX2 static inline uint32_t avx2_string_end_mask(char const* p) {
+    const __m256i v = _mm256_loadu_si256((__m256i const*) p);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+}
+
+LEXER_AVX2 static inline uint32_t avx2_newline_mask(char const* p) {
+    const __m256i v = _mm256_loadu_si256((__m256i const*) p);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+LEXER_AVX2 static inline uint32_t avx2_utf8_other_mask(char const* p) {
+    const __m256i v = _mm256_loadu_si256((__m256i const*) p);
+    const __m256i high = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(-9)), _mm256_cmpgt_epi8(_mm256_setzero_si256(), v));
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v), high));
+}
+
+// Scanners over whole blocks of width bytes, finishing with the scalar
+// ones. Runs stop at the first byte set in the stop mask
+#define LEXER_RUN(isa, name, width, attr, stop) \
+    attr static size_t isa##_##name(char const* data, size_t length) { \
+        size_t i = 0; \
+        for (; i + width <= length; i += width) { \
+            const uint32_t mask = stop; \
+            if (mask) \
+                return i + (size_t) sm_ctz64(mask); \
+        } \
+        return i + scalar_##name(data + i, length - i); \
+    }
+
+#define LEXER_SCANNERS(isa, width, attr) \
+    LEXER_RUN(isa, space, width, attr, ~isa##_space_mask(data + i) & (uint32_t) ((UINT64_C(1) << width) - 1)) \
+    LEXER_RUN(isa, token, width, attr, isa##_token_end_mask(data + i)) \
+    LEXER_RUN(isa, string, width, attr, isa##_string_end_mask(data + i)) \
+    \
+    attr static size_t isa##_newlines(char const* data, size_t length, size_t* last) { \
+        size_t count = 0; \
+        size_t i = 0; \
+        for (; i + width <= length; i += width) { \
+            const uint32_t mask = isa##_newline_mask(data + i); \
+            if (mask) { \
+                count += (size_t) sm_popcount64(mask); \
+                *last = i + 63 - (size_t) sm_clz64(mask); \
+            } \
+        } \
+        size_t tail_last = 0; \
+        const size_t tail = scalar_newlines(data + i, length - i, &tail_last); \
+        if (tail) \
+            *last = i + tail_last; \
+        return count + tail; \
+    } \
+    \
+    attr static size_t isa##_utf8_starts(char const* data, size_t length) { \
+        size_t count = 0; \
+        size_t i = 0; \
+        for (; i + width <= length; i += width) \
+            count += width - (size_t) sm_popcount64(isa##_utf8_other_mask(data + i)); \
+        return count + scalar_utf8_starts(data + i, length - i); \
+    }
+
+LEXER_SCANNERS(sse2, 16, )
+LEXER_SCANNERS(avx2, 32, LEXER_AVX2)
+
+#undef LEXER_SCANNERS
+#undef LEXER_RUN
+
+#endif
+
+static const LexerScanners scanners[LexerIsaCount] = {
+    { scalar_space, scalar_token, scalar_string, scalar_newlines, scalar_utf8_starts },
+#ifdef LEXER_X86
+    { sse2_space, sse2_token, sse2_string, sse2_newlines, sse2_utf8_starts },
+    { avx2_space, avx2_token, avx2_string, avx2_newlines, avx2_utf8_starts },
+#endif
+};
+
+static LexerScanners const* current = NULL;
+
+static bool supported(LexerIsa isa) {
+    switch (isa) {
+        case LexerScalar:
+            return true;
+
+    #ifdef LEXER_X86
+        case LexerSSE2:
+            return true;
+
+        case LexerAVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    #endif
+
+        default:
+            return false;
+    }
+}
+
+LexerScanners const* sm_lexer_scanners(void) {
+    if (!current) {
+        LexerIsa isa = LexerIsaCount - 1;
+        while (!supported(isa))
+            --isa;
+
+        current = &scanners[isa];
+    }
+
+    return current;
+}
+
+bool sm_lexer_select(LexerIsa isa) {
+    if (isa >= LexerIsaCount || !supported(isa))
+        return false;
+
+    current = &scanners[isa];
+    return true;
+}
@@ -149,7 +149,7 @@ int main(int argc, char** argv) {
 
     int exit_code = 0;
 
-    SmContext* ctx = sm_context((SmGCConfig) { 64, 2, 64 });
+    SmContext* ctx = sm_context((SmGCConfig) { 1 << 20, 2.0, 256 << 10 });
     sm_register_builtins(ctx);
     sm_context_register_function(ctx, sm_symbol(&ctx->symbols, sm_string_from_cstring("exit")), builtin_exit);
 
@@ -159,7 +159,7 @@ int main(int argc, char** argv) {
         return exit_code;
     }
 
-    SmValue* forms = sm_heap_root_value(&ctx->heap);
+    SmValue* form = sm_heap_root_value(&ctx->heap);
     SmValue* res = sm_heap_root_value(&ctx->heap);
 
     for (int i = 1; i < argc; ++i) {
@@ -176,32 +176,29 @@ int main(int argc, char** argv) {
             break;
         }
 
-        if (fseek(f, 0, SEEK_END) != 0) {
-            fclose(f);
-            fprintf(stderr, "%s: %s: cannot get file size: %s\n", progname, argv[i], strerror(errno));
-            exit_code = -1;
-            break;
-        }
+        // Evaluate each form before parsing the next one, so that only the
+        // current form and the source around it are kept in memory. Regular
+        // files are parsed in place from a mapping when possible
+        SmParser parser = sm_parser(sm_string_from_cstring(argv[i]), (SmString){ NULL, 0 });
+        SmReader reader = sm_reader(sm_reader_read_file, f);
+        sm_reader_map_file(&reader, f);
 
-        long size = ftell(f);
-        if (size == EOF) {
-            fclose(f);
-            fprintf(stderr, "%s: %s: cannot get file size: %s\n", progname, argv[i], strerror(errno));
-            exit_code = -1;
-            break;
-        }
+        SmError err = sm_ok;
+        bool done = false;
 
-        rewind(f);
+        while (sm_is_ok(err)) {
+            err = sm_parser_parse_next(&parser, &reader, ctx, form, &done);
+            if (!sm_is_ok(err) || done)
+                break;
 
-        if (size <= 0) {
-            fclose(f);
-            continue;
+            *res = sm_value_nil();
+            err = sm_eval(ctx, *form, res);
         }
 
-        char* buf = sm_aligned_alloc(16, size);
-        if (fread(buf, sizeof(char), size, f) < (size_t) size) {
+        sm_reader_drop(&reader);
+
+        if (ferror(f)) {
             fclose(f);
-            free(buf);
             fprintf(stderr, "%s: %s: read failed: %s\n", progname, argv[i], strerror(errno));
             exit_code = -1;
             break;
@@ -209,22 +206,6 @@ int main(int argc, char** argv) {
 
         fclose(f);
 
-        SmParser parser = sm_parser(sm_string_from_cstring(argv[i]), (SmString){ buf, size });
-
-        SmError err = sm_parser_parse_all(&parser, ctx, forms);
-        free(buf);
-
-        if (!sm_is_ok(err)) {
-            sm_report_error(stderr, err);
-            exit_code = -1;
-            break;
-        }
-
-        for (SmCons* form = forms->data.cons; sm_is_ok(err) && form; form = sm_list_next(form)) {
-            *res = sm_value_nil();
-            err = sm_eval(ctx, form->car, res);
-        }
-
         if (!sm_is_ok(err)) {
             sm_report_error(stderr, err);
             exit_code = -1;
@@ -9,6 +9,8 @@
 
 #include "hash.h"
 
+#include <string.h>
+
 //-----------------------------------------------------------------------------
 // Platform-specific functions and macros
 
@@ -36,7 +38,15 @@ static FORCE_INLINE uint32_t rotl32 ( uint32_t x, int8_t r )
 // Block read - if your platform needs to do endian-swapping or can only
 // handle aligned reads, do the conversion here
 
-#define getblock(p, i) (p[i])
+// Keys are interned straight from the source, at any alignment: memcpy
+// compiles to a plain load where unaligned reads are allowed
+
+static FORCE_INLINE uint32_t getblock ( const uint8_t * p, int i )
+{
+  uint32_t block;
+  memcpy(&block, p + i*4, sizeof(block));
+  return block;
+}
 
 //-----------------------------------------------------------------------------
 // Finalization mix - force all bits of a hash block to avalanche
@@ -68,7 +78,7 @@ uint32_t sm_hash(const void* data_, size_t size, uint32_t seed)
   //----------
   // body
 
-  const uint32_t * blocks = (const uint32_t *)(data + nblocks*4);
+  const uint8_t * blocks = data + nblocks*4;
 
   for(i = -nblocks; i; i++)
   {
@@ -1,12 +1,27 @@
+// Needed for mmap and fileno under strict C99
+#if !defined(_POSIX_C_SOURCE) && (defined(__unix__) || defined(__APPLE__))
+    #define _POSIX_C_SOURCE 200112L
+#endif
+
 #include "parser.h"
+#include "private/lexer.h"
 
 #include <ctype.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+
+    #define SM_READER_MMAP
+#endif
+
 // Inlines
 extern inline SmParser sm_parser(SmString name, SmString source);
+extern inline SmReader sm_reader(SmReaderFunction read, void* data);
 
 // Error message buffer
 static sm_thread_local char err_buf[1024];
@@ -73,32 +88,83 @@ static size_t consume(SmParser* parser, size_t amount) {
     return consumed;
 }
 
-static size_t consume_whitespace(SmParser* parser) {
-    // Also consumes comments
-    size_t consumed = 0;
+// Skip a run of bytes found by the scanners, counting a column per byte
+static void consume_bytes(SmParser* parser, LexerScanners const* scan, size_t bytes) {
+    size_t last = 0;
+    const size_t nl = scan->newlines(parser->source.data, bytes, &last);
 
-    bool comment = (*parser->source.data == ';');
+    parser->location.index += bytes;
+    parser->location.line += nl;
+    parser->location.col = nl ? bytes - last : parser->location.col + bytes;
 
-    while (parser->source.length > 0 && (isspace(*parser->source.data) || comment)) {
-        bool nl = (*parser->source.data == '\n');
+    parser->source.data += bytes;
+    parser->source.length -= bytes;
+}
 
-        ++parser->source.data;
-        --parser->source.length;
+// Skip a run of bytes found by the scanners ending on a character boundary,
+// counting a column per character as consume does
+static size_t consume_run(SmParser* parser, LexerScanners const* scan, size_t bytes) {
+    char const* data = parser->source.data;
+
+    if (bytes < LEXER_SHORT_RUN) {
+        for (size_t i = 0; i < bytes; ++i) {
+            if (data[i] == '\n') {
+                ++parser->location.line;
+                parser->location.col = 1;
+            } else if (i == 0 || lexer_is_utf8_start(data[i])) {
+                ++parser->location.col;
+            }
+        }
 
-        ++parser->location.index;
-        parser->location.line += nl;
-        parser->location.col = nl ? 1 : parser->location.col + 1;
+        parser->location.index += bytes;
+        parser->source.data += bytes;
+        parser->source.length -= bytes;
+
+        return bytes;
+    }
+
+    size_t last = 0;
+    const size_t nl = scan->newlines(data, bytes, &last);
 
-        ++consumed;
+    parser->location.index += bytes;
+    parser->location.line += nl;
+    parser->location.col = nl ?
+        1 + scan->utf8_starts(data + last + 1, bytes - last - 1) :
+        parser->location.col + 1 + scan->utf8_starts(data + 1, bytes - 1);
 
-        comment = (comment && !nl) || (parser->source.length > 0 && *parser->source.data == ';');
+    parser->source.data += bytes;
+    parser->source.length -= bytes;
+
+    return bytes;
+}
+
+static size_t consume_whitespace(SmParser* parser) {
+    // Also consumes comments, up to the newline ending them
+    LexerScanners const* scan = sm_lexer_scanners();
+    size_t consumed = 0;
+
+    while (parser->source.length > 0) {
+        size_t run = 0;
+
+        if (*parser->source.data == ';') {
+            char const* nl = memchr(parser->source.data, '\n', parser->source.length);
+            run = nl ? (size_t) (nl - parser->source.data) : parser->source.length;
+        } else {
+            run = scan->space(parser->source.data, parser->source.length);
+        }
+
+        if (!run)
+            break;
+
+        consume_bytes(parser, scan, run);
+        consumed += run;
     }
 
     return consumed;
 }
 
 static inline bool token_boundary(char c) {
-    return isspace(c) || c == '\'' || c == '"' || c == '(' || c == ')' || c == '`' || c == ',';
+    return lexer_is_space(c) || c == '\'' || c == '"' || c == '(' || c == ')' || c == '`' || c == ',';
 }
 
 static bool valid_integer(SmString str) {
@@ -163,6 +229,7 @@ static bool valid_float(SmString str) {
 }
 
 static Token lexer_next(SmParser* parser) {
+    LexerScanners const* scan = sm_lexer_scanners();
     consume_whitespace(parser);
 
     if (parser->source.length == 0)
@@ -205,10 +272,16 @@ static Token lexer_next(SmParser* parser) {
             tok.type = Truncated;
             tok.source.length += consume(parser, 1);
 
+            // A backslash escapes the character after it, quotes included
             while (parser->source.length > 0 && *parser->source.data != '"') {
+                const size_t run = scan->string(parser->source.data, parser->source.length);
+                if (run > 0) {
+                    tok.source.length += consume_run(parser, scan, run);
+                    continue;
+                }
+
                 tok.source.length += consume(parser, 1);
-                if (*parser->source.data == '\\')
-                    // Do not check source.length, this will return 0 at end of input
+                if (parser->source.length > 0)
                     tok.source.length += consume(parser, 1);
             }
 
@@ -227,6 +300,13 @@ static Token lexer_next(SmParser* parser) {
 
         default: // Enlarge token until next boundary, decide type later
             while (parser->source.length > 0 && !token_boundary(*parser->source.data)) {
+                // Skip to the next boundary or pipe at once
+                const size_t run = scan->token(parser->source.data, parser->source.length);
+                if (run > 0) {
+                    tok.source.length += consume_run(parser, scan, run);
+                    continue;
+                }
+
                 if (*parser->source.data == '|') {
                     tok.type = Truncated;
                     tok.source.length += consume(parser, 1);
@@ -241,6 +321,10 @@ static Token lexer_next(SmParser* parser) {
 
                 tok.source.length += consume(parser, 1);
             }
+
+            // The rest of the token may be in the next chunk
+            if (parser->partial && parser->source.length == 0)
+                tok.type = Truncated;
             break;
     }
 
@@ -353,6 +437,12 @@ static SmError parse_float(SmParser const* parser, SmContext const* ctx, Token t
 static SmError parse_symbol(SmParser const* parser, SmContext* ctx, Token tok, SmSymbol* ret) {
     sm_unused(parser);
 
+    // Without pipes the token is the name: intern it in place
+    if (!memchr(tok.source.data, '|', tok.source.length)) {
+        *ret = sm_symbol(&ctx->symbols, tok.source);
+        return sm_ok;
+    }
+
     char* buf = sm_aligned_alloc(16, tok.source.length*sizeof(char));
     char* end = buf + tok.source.length;
 
@@ -372,67 +462,146 @@ static SmError parse_symbol(SmParser const* parser, SmContext* ctx, Token tok, S
     return sm_ok;
 }
 
-static SmError parse_string(SmParser const* parser, SmContext* ctx, Token tok, SmString* ret) {
-    *ret = (SmString){ NULL, 0 };
+// Read digits hex digits at *p, advance *p past them
+static bool parse_hex(char const** p, char const* end, size_t digits, uint32_t* ret) {
+    if ((size_t) (end - *p) < digits)
+        return false;
+
+    *ret = 0;
+    for (char const* last = *p + digits; *p < last; ++*p) {
+        const char c = **p;
+
+        if (c >= '0' && c <= '9')
+            *ret = (*ret << 4) | (uint32_t) (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            *ret = (*ret << 4) | (uint32_t) (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            *ret = (*ret << 4) | (uint32_t) (c - 'A' + 10);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+// Encode a code point up to U+FFFF as UTF-8, return the byte count
+static size_t utf8_encode(uint32_t code, char* out) {
+    if (code < 0x80) {
+        out[0] = (char) code;
+        return 1;
+    } else if (code < 0x800) {
+        out[0] = (char) (0xc0 | (code >> 6));
+        out[1] = (char) (0x80 | (code & 0x3f));
+        return 2;
+    }
+
+    out[0] = (char) (0xe0 | (code >> 12));
+    out[1] = (char) (0x80 | ((code >> 6) & 0x3f));
+    out[2] = (char) (0x80 | (code & 0x3f));
+    return 3;
+}
+
+static SmError parse_string(SmParser const* parser, SmContext* ctx, Token tok, SmStringHeader const** ret) {
+    *ret = NULL;
 
-    if (tok.source.length <= 2)
+    // Without escapes the contents are the string: copy them as they are
+    const SmString contents = { tok.source.data + 1, tok.source.length - 2 };
+    char const* escape = memchr(contents.data, '\\', contents.length);
+    if (!escape) {
+        *ret = sm_heap_alloc_string_value(&ctx->heap, ctx, contents);
         return sm_ok;
+    }
 
-    char* buf = sm_aligned_alloc(16, (tok.source.length - 2)*sizeof(char));
-    char* end = buf + tok.source.length - 2;
+    // Escapes never decode to more bytes than they take in the source
+    char* buf = sm_aligned_alloc(16, contents.length*sizeof(char));
+    char* out = buf;
 
-    strncpy(buf, tok.source.data + 1, tok.source.length - 2);
+    char const* in = contents.data;
+    char const* const end = contents.data + contents.length;
 
-    for (char* p = buf; p < end; ++p) {
-        if (*p == '\\') {
-            memmove(p, p + 1, end - p - 1);
-            --end;
+    char const* msg = NULL;
 
-            switch (*p) {
-                case '\\':
-                    *p = '\\';
-                    break;
-                case '\"':
-                    *p = '\"';
-                    break;
-                case 'n':
-                    *p = '\n';
-                    break;
-                case 'r':
-                    *p = '\r';
-                    break;
-                case 'b':
-                    *p = '\b';
-                    break;
-                case 't':
-                    *p = '\t';
-                    break;
-                case 'f':
-                    *p = '\f';
-                    break;
-                case 'a':
-                    *p = '\a';
-                    break;
-                case 'v':
-                    *p = '\v';
-                    break;
-                default:
-                    free(buf);
-                    return parser_error(parser, tok, ctx, SmErrorInvalidLiteral, "invalid escape sequence in string literal");
-            }
+    // Copy the runs between escapes as they are, decode escapes in between
+    while (escape && !msg) {
+        memcpy(out, in, escape - in);
+        out += escape - in;
+        in = escape + 1;
+
+        if (in == end) {
+            msg = "invalid escape sequence in string literal";
+            break;
         }
+
+        uint32_t code = 0;
+
+        switch (*in++) {
+            case '\\':
+                *out++ = '\\';
+                break;
+            case '\"':
+                *out++ = '\"';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'a':
+                *out++ = '\a';
+                break;
+            case 'v':
+                *out++ = '\v';
+                break;
+            case 'x':
+                if (!parse_hex(&in, end, 2, &code))
+                    msg = "two hex digits expected after \\x in string literal";
+                else
+                    *out++ = (char) code;
+                break;
+            case 'u':
+                if (!parse_hex(&in, end, 4, &code))
+                    msg = "four hex digits expected after \\u in string literal";
+                else if (code >= 0xd800 && code <= 0xdfff)
+                    msg = "surrogate code point in \\u escape in string literal";
+                else
+                    out += utf8_encode(code, out);
+                break;
+            default:
+                msg = "invalid escape sequence in string literal";
+                break;
+        }
+
+        escape = memchr(in, '\\', end - in);
     }
 
-    *ret = sm_symbol_str(sm_symbol(&ctx->symbols, (SmString){ buf, end - buf }));
+    if (msg) {
+        free(buf);
+        return parser_error(parser, tok, ctx, SmErrorInvalidLiteral, msg);
+    }
+
+    memcpy(out, in, end - in);
+    out += end - in;
+
+    *ret = sm_heap_alloc_string_value(&ctx->heap, ctx, (SmString){ buf, out - buf });
     free(buf);
 
     return sm_ok;
 }
 
-static const SmString symbol_comma_str = { "<template:comma>", 16 };
-static const SmSymbol symbol_comma = &symbol_comma_str;
-static const SmString symbol_splice_str = { "<template:splice>", 17 };
-static const SmSymbol symbol_splice = &symbol_splice_str;
+static const SmSymbolHeader symbol_comma_header = { { "<template:comma>", 16 }, 0, SmSymbolPlain, 0 };
+static const SmSymbol symbol_comma = &symbol_comma_header;
+static const SmSymbolHeader symbol_splice_header = { { "<template:splice>", 17 }, 0, SmSymbolPlain, 0 };
+static const SmSymbol symbol_splice = &symbol_splice_header;
 
 static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmValue* form) {
     const SmSymbol add_quote = sm_symbol(&ctx->symbols, sm_string_from_cstring("add-quote"));
@@ -448,15 +617,19 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
         return sm_ok;
     }
 
+    // Forms are rewritten in place: form may point into an old cons, so
+    // every store is followed by a write barrier
     while (sm_value_is_quoted(*form)) {
         SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
         cons->car = sm_value_symbol(add_quote);
         cons->cdr = sm_value_unquote(*form, 1); // Store temporarily to avoid GC
         *form = sm_value_cons(cons);
+        sm_heap_write_barrier(&ctx->heap, form);
 
         SmCons* arg = sm_heap_alloc_cons(&ctx->heap, ctx);
         arg->car = cons->cdr;
         cons->cdr = sm_value_cons(arg);
+        sm_heap_write_barrier(&ctx->heap, cons);
 
         form = &arg->car;
     }
@@ -464,6 +637,7 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
     if (sm_value_is_symbol(form->data.cons->car)) {
         if (form->data.cons->car.data.symbol == symbol_comma) {
             *form = form->data.cons->cdr;
+            sm_heap_write_barrier(&ctx->heap, form);
             return sm_ok;
         } else if (form->data.cons->car.data.symbol == symbol_splice) {
             return parser_error(parser, tok, ctx, SmErrorSyntaxError, "splice operator found in template outside list");
@@ -474,6 +648,7 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
     prefix->car = sm_value_symbol(list);
     prefix->cdr = *form;
     *form = sm_value_cons(prefix);
+    sm_heap_write_barrier(&ctx->heap, form);
 
     for (SmCons *cons = prefix->cdr.data.cons, *prev = NULL; cons; prev = cons, cons = sm_list_next(cons)) {
         if (sm_value_is_symbol(cons->car)) {
@@ -481,6 +656,7 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
                 prefix->car = sm_value_symbol(list_dot);
                 cons->car = cons->cdr;
                 cons->cdr = sm_value_nil();
+                sm_heap_write_barrier(&ctx->heap, cons);
                 continue;
             } else if (cons->car.data.symbol == symbol_splice) {
                 return parser_error(parser, tok, ctx, SmErrorSyntaxError, "splice operator found in list template after dot");
@@ -488,25 +664,30 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
         } else if (sm_value_is_cons(cons->car) && !sm_value_is_quoted(cons->car) && sm_value_is_symbol(cons->car.data.cons->car)) {
             if (cons->car.data.cons->car.data.symbol == symbol_comma) {
                 cons->car = cons->car.data.cons->cdr;
+                sm_heap_write_barrier(&ctx->heap, cons);
                 continue;
             } else if (cons->car.data.cons->car.data.symbol == symbol_splice) {
                 if (sm_value_is_nil(cons->cdr) && !sm_value_is_quoted(cons->cdr)) {
                     prefix->car = sm_value_symbol(list_dot);
                     cons->car = cons->car.data.cons->cdr;
+                    sm_heap_write_barrier(&ctx->heap, cons);
                 } else if (!prev) {
                     prefix->car = sm_value_symbol(append);
                     cons->car = cons->car.data.cons->cdr;
+                    sm_heap_write_barrier(&ctx->heap, cons);
 
                     // Promote cdr to cons
                     SmCons* last = sm_heap_alloc_cons(&ctx->heap, ctx);
                     last->car = cons->cdr;
                     cons->cdr = sm_value_cons(last);
+                    sm_heap_write_barrier(&ctx->heap, cons);
                 } else {
                     // Wrap old prefix in new cons
                     SmCons* wrap = sm_heap_alloc_cons(&ctx->heap, ctx);
                     wrap->car = sm_value_cons(prefix);
                     wrap->cdr = sm_value_cons(cons);
                     *form = sm_value_cons(wrap);
+                    sm_heap_write_barrier(&ctx->heap, form);
 
                     // Unlink the current cons from its predecessor
                     prev->cdr = sm_value_nil();
@@ -516,14 +697,17 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
                     prefix->car = sm_value_symbol(append);
                     prefix->cdr = sm_value_cons(wrap);
                     *form = sm_value_cons(prefix);
+                    sm_heap_write_barrier(&ctx->heap, form);
 
                     // Promote spliced expression to car
                     cons->car = cons->car.data.cons->cdr;
+                    sm_heap_write_barrier(&ctx->heap, cons);
 
                     // Promote cdr to cons
                     SmCons* last = sm_heap_alloc_cons(&ctx->heap, ctx);
                     last->car = cons->cdr;
                     cons->cdr = sm_value_cons(last);
+                    sm_heap_write_barrier(&ctx->heap, cons);
                 }
                 continue;
             }
@@ -545,6 +729,7 @@ static SmError build_template(SmParser* parser, SmContext* ctx, Token tok, SmVal
             SmCons* last = sm_heap_alloc_cons(&ctx->heap, ctx);
             last->car = cons->cdr;
             cons->cdr = sm_value_cons(last);
+            sm_heap_write_barrier(&ctx->heap, cons);
         }
     }
 
@@ -594,6 +779,7 @@ SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form) {
         case Comma: {
             SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
             *form = sm_value_cons(cons);
+            sm_heap_write_barrier(&ctx->heap, form);
             cons->car = sm_value_symbol(symbol_comma);
             err = sm_parser_parse_form(parser, ctx, &cons->cdr);
             break;
@@ -602,6 +788,7 @@ SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form) {
         case Splice: {
             SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
             *form = sm_value_cons(cons);
+            sm_heap_write_barrier(&ctx->heap, form);
             cons->car = sm_value_symbol(symbol_splice);
             err = sm_parser_parse_form(parser, ctx, &cons->cdr);
             break;
@@ -624,10 +811,15 @@ SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form) {
             break;
         }
 
-        case String:
-            *form = sm_value_string((SmString){ NULL, 0 });
-            err = parse_string(parser, ctx, tok, &form->data.string);
+        case String: {
+            SmStringHeader const* string = NULL;
+            err = parse_string(parser, ctx, tok, &string);
+            *form = string ? sm_value_string(string) : sm_value_nil();
+
+            // form may point into an old cons
+            sm_heap_write_barrier(&ctx->heap, form);
             break;
+        }
 
         case LParen: {
             // Parse list
@@ -642,6 +834,9 @@ SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form) {
                 SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
                 *form = sm_value_cons(cons);
 
+                // Lists are built in place: form may point into an old cons
+                sm_heap_write_barrier(&ctx->heap, form);
+
                 while (tok.type != RParen && tok.type != End) {
                     err = sm_parser_parse_form(parser, ctx, &cons->car);
                     if (!sm_is_ok(err))
@@ -676,6 +871,7 @@ SmError sm_parser_parse_form(SmParser* parser, SmContext* ctx, SmValue* form) {
                         }
                     } else if (tok.type != RParen && tok.type != End) {
                         cons->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+                        sm_heap_write_barrier(&ctx->heap, cons);
                         cons = cons->cdr.data.cons;
                     }
                 }
@@ -733,6 +929,7 @@ SmError sm_parser_parse_all(SmParser* parser, SmContext* ctx, SmValue* list) {
     while (sm_is_ok(err) && !sm_parser_finished(parser))
     {
         form->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+        sm_heap_write_barrier(&ctx->heap, form);
         form = form->cdr.data.cons;
 
         err = sm_parser_parse_form(parser, ctx, &form->car);
@@ -744,6 +941,124 @@ SmError sm_parser_parse_all(SmParser* parser, SmContext* ctx, SmValue* list) {
     return err;
 }
 
+// Reader functions
+void sm_reader_drop(SmReader* reader) {
+    #ifdef SM_READER_MMAP
+        if (reader->mapped)
+            munmap(reader->buf, reader->capacity);
+        else
+            free(reader->buf);
+    #else
+        free(reader->buf);
+    #endif
+
+    reader->buf = NULL;
+    reader->capacity = 0;
+    reader->mapped = false;
+}
+
+size_t sm_reader_read_file(void* file, char* buf, size_t size) {
+    return fread(buf, sizeof(char), size, (FILE*) file);
+}
+
+bool sm_reader_map_file(SmReader* reader, FILE* file) {
+    #ifdef SM_READER_MMAP
+        const int fd = fileno(file);
+
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+            return false;
+
+        if (st.st_size <= 0 || (uintmax_t) st.st_size > SIZE_MAX)
+            return false;
+
+        const size_t size = (size_t) st.st_size;
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            return false;
+
+        // Tokens are only looked at once, front to back
+        posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+        sm_reader_drop(reader);
+        *reader = (SmReader){ NULL, NULL, map, size, false, true };
+
+        return true;
+    #else
+        sm_unused(reader);
+        sm_unused(file);
+        return false;
+    #endif
+}
+
+// Move the source left to parse to the start of the buffer, then fill it
+// with what the reader returns, growing the buffer first if it is full
+static void reader_fill(SmReader* reader, SmParser* parser) {
+    // Mapped sources are available at once
+    if (reader->mapped) {
+        parser->source = (SmString){ reader->buf, reader->capacity };
+        reader->end = true;
+        return;
+    }
+
+    const size_t pending = parser->source.length;
+
+    if (pending > 0 && parser->source.data != reader->buf)
+        memmove(reader->buf, parser->source.data, pending);
+
+    if (pending == reader->capacity) {
+        reader->capacity = reader->capacity ? reader->capacity*2 : SM_READER_BUFFER_SIZE;
+        reader->buf = realloc(reader->buf, reader->capacity*sizeof(char));
+        sm_guard(reader->buf != NULL, "allocation failed");
+    }
+
+    // Readers may return less than asked: keep reading, so that large
+    // forms are parsed again once per buffer doubling, not once per read
+    size_t length = pending;
+    while (length < reader->capacity) {
+        const size_t count = reader->read(reader->data, reader->buf + length, reader->capacity - length);
+        if (count == 0) {
+            reader->end = true;
+            break;
+        }
+
+        length += count;
+    }
+
+    parser->source = (SmString){ reader->buf, length };
+}
+
+SmError sm_parser_parse_next(SmParser* parser, SmReader* reader, SmContext* ctx, SmValue* form, bool* done) {
+    while (true) {
+        SmParser attempt = *parser;
+        attempt.partial = !reader->end;
+        SmError err = sm_ok;
+
+        *done = sm_parser_finished(&attempt);
+        *form = sm_value_nil();
+
+        // A form followed by more source cannot continue in the next
+        // chunk, neither can an error found before the end of the buffer
+        bool complete = false;
+        if (!*done) {
+            err = sm_parser_parse_form(&attempt, ctx, form);
+
+            SmParser rest = attempt;
+            complete = !sm_parser_finished(&rest);
+        }
+
+        if (complete || reader->end) {
+            attempt.partial = parser->partial;
+            *parser = attempt;
+            return err;
+        }
+
+        // Tokens, comments and lists may be split across chunks: parse
+        // again from the same point when more source is available
+        reader_fill(reader, parser);
+    }
+}
+
 bool sm_can_parse_float(SmString str) {
     return valid_float(str);
 }
@@ -0,0 +1,107 @@
+#include "context.h"
+#include "parser.h"
+#include "private/lexer.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double elapsed(uint64_t start) {
+    return ((double) (sm_clock_ns() - start))/1e9;
+}
+
+// Build a string literal of about size bytes repeating chunk
+static char* literal(char const* chunk, size_t size) {
+    const size_t length = strlen(chunk);
+    const size_t count = size/length;
+
+    char* source = malloc(count*length + 3);
+    sm_guard(source != NULL, "allocation failed");
+
+    char* p = source;
+    *p++ = '"';
+    for (size_t i = 0; i < count; ++i, p += length)
+        memcpy(p, chunk, length);
+    *p++ = '"';
+    *p = '\0';
+
+    return source;
+}
+
+// Build about size bytes of source repeating chunk
+static char* repeat(char const* chunk, size_t size) {
+    const size_t length = strlen(chunk);
+    const size_t count = size/length;
+
+    char* source = malloc(count*length + 1);
+    sm_guard(source != NULL, "allocation failed");
+
+    for (size_t i = 0; i < count; ++i)
+        memcpy(source + i*length, chunk, length);
+    source[count*length] = '\0';
+
+    return source;
+}
+
+// Parse every form in source once
+static double bench_parse(SmContext* ctx, char const* source) {
+    SmValue* forms = sm_heap_root_value(&ctx->heap);
+    SmParser parser = sm_parser(sm_string_from_cstring("<bench>"), sm_string_from_cstring(source));
+
+    const uint64_t start = sm_clock_ns();
+    SmError err = sm_parser_parse_all(&parser, ctx, forms);
+    const double time = elapsed(start);
+
+    sm_guard(sm_is_ok(err), "parse failed");
+    sm_heap_root_value_drop(&ctx->heap, ctx, forms);
+
+    return time;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t size = ((argc > 1) ? (size_t) strtoull(argv[1], NULL, 10) : 50) << 20;
+
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+
+    // JSON-ish blob: every few characters are escaped
+    char* escaped = literal("{\\\"key\\\": \\\"va\\u00e9\\\\lue\\\", \\\"n\\\": [1, 2]}\\n", size);
+    printf("escape-heavy literal:  %zu MB: %.3f s\n", size >> 20, bench_parse(ctx, escaped));
+    free(escaped);
+
+    char* plain = literal("{'key': 'value', 'n': [1, 2]} ", size);
+    printf("literal, no escapes:   %zu MB: %.3f s\n", size >> 20, bench_parse(ctx, plain));
+    free(plain);
+
+    // Lexer throughput with each scanner implementation available
+    char const* const isa_names[] = { "scalar", "sse2", "avx2" };
+
+    char* code = repeat(
+        "(set 'fold-left (lambda (function accumulator sequence)\n"
+        "    ; Apply function to the elements of sequence, left to right\n"
+        "    (if sequence\n"
+        "        (fold-left function (function accumulator (car sequence)) (cdr sequence))\n"
+        "        accumulator)))\n\n", size);
+    char* comments = repeat(
+        ";; ------------------------------------------------------------------\n"
+        ";;   Generated data, comments and indentation dominate the source    \n"
+        ";; ------------------------------------------------------------------\n"
+        "                                                      (entry 1 2.5 key)\n", size);
+
+    for (LexerIsa isa = LexerScalar; isa < LexerIsaCount; ++isa) {
+        if (!sm_lexer_select(isa))
+            continue;
+
+        printf("lexer %-6s code:      %zu MB: %.0f MB/s\n",
+            isa_names[isa], size >> 20, (double) (size >> 20)/bench_parse(ctx, code));
+        printf("lexer %-6s comments:  %zu MB: %.0f MB/s\n",
+            isa_names[isa], size >> 20, (double) (size >> 20)/bench_parse(ctx, comments));
+    }
+
+    free(comments);
+    free(code);
+
+    sm_context_drop(ctx);
+
+    return 0;
+}
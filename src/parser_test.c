@@ -0,0 +1,378 @@
+#include "context.h"
+#include "hash.h"
+#include "parser.h"
+#include "private/lexer.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Hands out source a few bytes at a time
+typedef struct ChunkReader {
+    char const* source;
+    size_t chunk;
+} ChunkReader;
+
+static size_t read_chunk(void* data, char* buf, size_t size) {
+    ChunkReader* reader = data;
+
+    size_t count = strlen(reader->source);
+    count = count < reader->chunk ? count : reader->chunk;
+    count = count < size ? count : size;
+
+    memcpy(buf, reader->source, count);
+    reader->source += count;
+
+    return count;
+}
+
+// Repeats a form until count bytes have been handed out
+typedef struct RepeatReader {
+    char const* form;
+    size_t offset;
+    size_t count;
+} RepeatReader;
+
+static size_t read_repeat(void* data, char* buf, size_t size) {
+    RepeatReader* reader = data;
+    const size_t length = strlen(reader->form);
+
+    size = size < reader->count ? size : reader->count;
+    for (size_t i = 0; i < size; ++i) {
+        buf[i] = reader->form[reader->offset];
+        reader->offset = (reader->offset + 1) % length;
+    }
+
+    reader->count -= size;
+    return size;
+}
+
+static bool same(SmValue a, SmValue b) {
+    while (sm_value_is_cons(a) && sm_value_is_cons(b) && a.quotes == b.quotes) {
+        if (!same(a.data.cons->car, b.data.cons->car))
+            return false;
+
+        a = a.data.cons->cdr;
+        b = b.data.cons->cdr;
+    }
+
+    if (a.type != b.type || a.quotes != b.quotes)
+        return false;
+
+    switch (a.type) {
+        case SmTypeNil:
+            return true;
+        case SmTypeNumber:
+            return memcmp(&a.data.number, &b.data.number, sizeof(SmNumber)) == 0;
+        case SmTypeString:
+            return a.data.string->hash == b.data.string->hash &&
+                a.data.string->str.length == b.data.string->str.length &&
+                memcmp(a.data.string->str.data, b.data.string->str.data, a.data.string->str.length) == 0;
+        default:
+            return a.data.symbol == b.data.symbol;
+    }
+}
+
+// Parse source through reader, expect the forms and the error parse_all
+// returns on the whole source
+static bool reads_like_parse_all(char const* source, SmReader reader) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmValue* forms = sm_heap_root_value(&ctx->heap);
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+
+    SmParser whole = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+    SmError expected = sm_parser_parse_all(&whole, ctx, forms);
+
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), (SmString){ NULL, 0 });
+
+    bool ok = true;
+    bool done = false;
+    SmCons* next = forms->data.cons;
+
+    while (ok) {
+        SmError err = sm_parser_parse_next(&parser, &reader, ctx, form, &done);
+        if (!sm_is_ok(err)) {
+            // Forms before the error must have been returned already
+            ok = !sm_is_ok(expected) && err.code == expected.code &&
+                parser.location.line == whole.location.line;
+            break;
+        }
+
+        if (done) {
+            ok = sm_is_ok(expected) && next == NULL;
+            break;
+        }
+
+        ok = next ? same(*form, next->car) : !sm_is_ok(expected);
+        next = next ? sm_list_next(next) : NULL;
+    }
+
+    sm_reader_drop(&reader);
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+    sm_heap_root_value_drop(&ctx->heap, ctx, forms);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Parse a single string literal, expect its decoded bytes or, if expected
+// is NULL, an invalid literal error
+static bool decodes_to(char const* source, char const* expected, size_t length) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+    SmError err = sm_parser_parse_form(&parser, ctx, form);
+
+    const bool ok = expected
+        ? sm_is_ok(err) && sm_value_is_string(*form) && form->data.string->str.length == length &&
+            memcmp(form->data.string->str.data, expected, length) == 0 &&
+            sm_parser_finished(&parser)
+        : err.code == SmErrorInvalidLiteral;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Parse count unique string literals, dropping each, then collect: they
+// must be freed and never reach the symbol set
+static bool literals_collected(size_t count) {
+    SmContext* ctx = sm_context((SmGCConfig){ (size_t) -1, 2.0, 0 });
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+
+    const size_t symbols = sm_symbol_set_size(&ctx->symbols);
+    const size_t objects = sm_heap_size(&ctx->heap);
+
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; ++i) {
+        char source[64];
+        snprintf(source, sizeof(source), "\"unique string %zu\"", i);
+
+        SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+        ok = sm_is_ok(sm_parser_parse_form(&parser, ctx, form)) && sm_value_is_string(*form) &&
+            sm_heap_is_managed(&ctx->heap, form->data.string) &&
+            form->data.string->hash == sm_hash_str(form->data.string->str, 0);
+    }
+
+    *form = sm_value_nil();
+    sm_heap_gc(&ctx->heap, ctx);
+
+    ok = ok && sm_symbol_set_size(&ctx->symbols) == symbols && sm_heap_size(&ctx->heap) == objects;
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Stream source in chunks of several sizes, through every lexer scanner
+// implementation available
+static bool streams_in_chunks(char const* source) {
+    const size_t chunks[] = { 1, 2, 3, 7, 64 };
+    bool ok = true;
+
+    for (LexerIsa isa = LexerScalar; isa < LexerIsaCount; ++isa) {
+        if (!sm_lexer_select(isa))
+            continue;
+
+        for (size_t i = 0; i < sizeof(chunks)/sizeof(chunks[0]) && ok; ++i) {
+            ChunkReader reader = { source, chunks[i] };
+            ok = reads_like_parse_all(source, sm_reader(read_chunk, &reader));
+        }
+    }
+
+    return ok;
+}
+
+// Parse forms from source, expect the parser to be at each location in
+// turn after them with every lexer scanner implementation
+static bool locates(char const* source, SmSourceLoc const* expected, size_t count) {
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+    bool ok = true;
+
+    for (LexerIsa isa = LexerScalar; isa < LexerIsaCount; ++isa) {
+        if (!sm_lexer_select(isa))
+            continue;
+
+        SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+
+        for (size_t i = 0; i < count && ok; ++i) {
+            sm_parser_parse_form(&parser, ctx, form);
+            ok = parser.location.index == expected[i].index &&
+                parser.location.line == expected[i].line && parser.location.col == expected[i].col;
+        }
+    }
+
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+    sm_context_drop(ctx);
+
+    return ok;
+}
+
+// Stream source in small chunks, expect the symbol set to end up as after
+// parsing it whole: tokens cut at the end of a chunk must not be interned
+static bool interns_like_parse_all(char const* source) {
+    SmContext* whole = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmContext* ctx = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmValue* forms = sm_heap_root_value(&whole->heap);
+    SmValue* form = sm_heap_root_value(&ctx->heap);
+
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), sm_string_from_cstring(source));
+    bool ok = sm_is_ok(sm_parser_parse_all(&parser, whole, forms));
+
+    ChunkReader chunks = { source, 7 };
+    SmReader reader = sm_reader(read_chunk, &chunks);
+    parser = sm_parser(sm_string_from_cstring("<test>"), (SmString){ NULL, 0 });
+
+    bool done = false;
+    while (ok && !done)
+        ok = sm_is_ok(sm_parser_parse_next(&parser, &reader, ctx, form, &done));
+
+    ok = ok && sm_symbol_set_size(&ctx->symbols) == sm_symbol_set_size(&whole->symbols);
+
+    sm_reader_drop(&reader);
+    sm_heap_root_value_drop(&ctx->heap, ctx, form);
+    sm_heap_root_value_drop(&whole->heap, whole, forms);
+    sm_context_drop(ctx);
+    sm_context_drop(whole);
+
+    return ok;
+}
+
+// Write source to a temporary file, then parse it from a mapping where
+// supported, or by reading it otherwise
+static bool maps_like_parse_all(char const* source) {
+    FILE* file = tmpfile();
+    if (!file)
+        return false;
+
+    const size_t length = strlen(source);
+    bool ok = fwrite(source, sizeof(char), length, file) == length && fflush(file) == 0;
+
+    if (ok) {
+        rewind(file);
+
+        SmReader reader = sm_reader(sm_reader_read_file, file);
+        sm_reader_map_file(&reader, file);
+
+        ok = reads_like_parse_all(source, reader);
+    }
+
+    fclose(file);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    SmTestContext ctx = sm_test_context(argc, argv);
+
+    sm_test(&ctx, "sm_parser_parse_next should parse forms split across chunks",
+        streams_in_chunks(
+            "(set 'square (lambda (x) (* x x))) ; comment split across chunks\n"
+            "12345678 -3.25e2 |sym bol| \"a \\\"string\\\"\\n\" :key nil\n"
+            "'(a . b) `(a ,b ,@c) ((()))\n"
+            "; trailing comment") &&
+        streams_in_chunks("") &&
+        streams_in_chunks("  ; only a comment") &&
+        streams_in_chunks("atom"));
+
+    sm_test(&ctx, "sm_parser_parse_next should report errors after the forms before them",
+        streams_in_chunks("(a b) (c d") &&
+        streams_in_chunks("1 2 \"unterminated") &&
+        streams_in_chunks("(a b))") &&
+        streams_in_chunks("x 'y '"));
+
+    // Columns count characters in tokens, bytes in whitespace and comments
+    const SmSourceLoc locations[] = { { 14, 2, 5 }, { 39, 3, 9 }, { 47, 4, 4 }, { 61, 4, 18 } };
+    sm_test(&ctx, "the lexer should track lines and columns across blocks",
+        locates(
+            "(a \"\xc3\xa9\xe2\x82\xac\nxy\")   ; comment \xc3\xa9\n"
+            "\t  sym-\xc3\xa9  |p\nq|r \"unterminated", locations, 4));
+
+    sm_test(&ctx, "string literals should decode escapes",
+        decodes_to("\"plain\"", "plain", 5) &&
+        decodes_to("\"\\\"quoted\\\" \\\\ \\n\"", "\"quoted\" \\ \n", 12) &&
+        decodes_to("\"\\\"\"", "\"", 1) &&
+        decodes_to("\"a\\x41\\x7e\\x00b\"", "aA~\0b", 5) &&
+        decodes_to("\"\\u0041\\u00e9\\u20AC\"", "A\xc3\xa9\xe2\x82\xac", 6));
+
+    sm_test(&ctx, "string literals should reject invalid escapes",
+        decodes_to("\"\\q\"", NULL, 0) &&
+        decodes_to("\"\\x4\"", NULL, 0) &&
+        decodes_to("\"\\xg0\"", NULL, 0) &&
+        decodes_to("\"\\u12\"", NULL, 0) &&
+        decodes_to("\"\\ud800\"", NULL, 0));
+
+    sm_test(&ctx, "string literals should be heap values, not interned",
+        literals_collected(10000));
+
+    // Tokens at the very end of a page must not be read past it
+    char string_page[4097], symbol_page[4097], atom_page[4097];
+    memset(string_page, ' ', 4096);
+    memcpy(string_page, "(a b)", 5);
+    string_page[4096] = '\0';
+
+    memcpy(symbol_page, string_page, sizeof(string_page));
+    memcpy(atom_page, string_page, sizeof(string_page));
+
+    memcpy(string_page + 4091, "\"abc\\", 5);
+    memcpy(symbol_page + 4091, "|sym ", 5);
+    memcpy(atom_page + 4091, " tail", 5);
+
+    sm_test(&ctx, "sm_reader_map_file should parse files in place",
+        maps_like_parse_all("(set 'x \"string\") ; comment\n12 |a b| 'c") &&
+        maps_like_parse_all("") &&
+        maps_like_parse_all(string_page) &&
+        maps_like_parse_all(symbol_page) &&
+        maps_like_parse_all(atom_page));
+
+    // One form larger than the buffer, made of distinct symbols
+    const size_t symbols = 3*SM_READER_BUFFER_SIZE/16;
+    char* large = malloc(symbols*16 + 3);
+    sm_guard(large != NULL, "allocation failed");
+
+    char* p = large;
+    *p++ = '(';
+    for (size_t i = 0; i < symbols; ++i)
+        p += sprintf(p, "symbol-%08zu ", i);
+    *p++ = ')';
+    *p = '\0';
+
+    sm_test(&ctx, "sm_parser_parse_next should not intern tokens split across chunks",
+        interns_like_parse_all(large) &&
+        interns_like_parse_all("(abc defgh) ijklmnop"));
+
+    free(large);
+
+    // The buffer must not grow with the length of the source
+    SmContext* lisp = sm_context((SmGCConfig){ 1 << 20, 2.0, 256 << 10 });
+    SmValue* form = sm_heap_root_value(&lisp->heap);
+
+    char const* repeated = "(list 1 \"two\" 'three) ; four\n";
+    const size_t forms = 16*SM_READER_BUFFER_SIZE/strlen(repeated);
+
+    RepeatReader repeat = { repeated, 0, forms*strlen(repeated) };
+    SmReader reader = sm_reader(read_repeat, &repeat);
+    SmParser parser = sm_parser(sm_string_from_cstring("<test>"), (SmString){ NULL, 0 });
+
+    size_t count = 0;
+    bool done = false;
+    SmError err = sm_ok;
+
+    while (sm_is_ok(err = sm_parser_parse_next(&parser, &reader, lisp, form, &done)) && !done)
+        ++count;
+
+    sm_test(&ctx, "sm_parser_parse_next should keep a bounded buffer",
+        sm_is_ok(err) && count == forms &&
+        reader.capacity == SM_READER_BUFFER_SIZE);
+
+    sm_reader_drop(&reader);
+    sm_heap_root_value_drop(&lisp->heap, lisp, form);
+    sm_context_drop(lisp);
+
+    return !sm_test_report(&ctx);
+}
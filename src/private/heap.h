@@ -6,58 +6,106 @@
 
 #include <stdint.h>
 
-#if (SIZE_MAX == 0xFFFF)
-    #define SIZE_BITS 12
-#elif (SIZE_MAX == 0xFFFFFFFF)
-    #define SIZE_BITS 28
-#elif (SIZE_MAX == 0xFFFFFFFFFFFFFFFF)
-    #define SIZE_BITS 60
-#else
-    #error Cannot determine size_t bits
-#endif
-
 typedef enum Type {
-    Symbol = 0,
-    Cons,
-    Scope,
-    Function,
-    String
+    Symbol = SmHeapObjectSymbol,
+    Cons = SmHeapObjectCons,
+    Scope = SmHeapObjectScope,
+    Function = SmHeapObjectFunction,
+    String = SmHeapObjectString
 } Type;
 
-// Objects implement an AVL augmented tree
-typedef struct SmHeapObject {
-    struct SmHeapObject* parent;
-    struct SmHeapObject* left;
-    struct SmHeapObject* right;
+// Slab geometry: chunks are aligned to their size, so masking any
+// pointer into the first CHUNK_SIZE bytes of a chunk yields its header
+#define CHUNK_SIZE ((size_t) 1 << 16)
+#define CHUNK_MASK (~((uintptr_t) CHUNK_SIZE - 1))
 
-    bool marked : 1;
-    bool all_marked : 1;
-    unsigned int type : 2;
-    size_t height : SIZE_BITS;
+#define STRING_CLASS_MIN ((size_t) 16)
+#define STRING_CLASS_MAX ((size_t) 2048)
 
-    uintptr_t end;
-    uintptr_t lower_bound;
-    uintptr_t upper_bound;
+// Size class indices (strings take one class per power of two)
+enum SizeClass {
+    ClassSymbol = 0,
+    ClassCons,
+    ClassScope,
+    ClassFunction,
+    ClassString,
+    ClassLarge = SM_HEAP_CLASS_COUNT - 1
+};
 
+// Objects live in fixed size slots inside chunks, their state is kept
+// in per-chunk bitmaps
+typedef struct SmHeapObject {
     union Data {
-        SmString symbol;
+        SmSymbolHeader symbol;
         SmCons cons;
         SmScope scope;
         SmFunction function;
         char string;
-    } data;
 
-    uint8_t mem[];
+        struct SmHeapObject* next; // Free list link
+    } data;
 } Object;
 
-typedef struct SmHeapRoot {
-    struct SmHeapRoot* next;
-    struct SmHeapRoot* prev;
+// Chunk header, stored at the start of each aligned chunk and followed
+// by the live, mark, old and remembered bitmaps, then by object slots
+typedef struct SmHeapChunk {
+    struct SmHeapChunk* next; // Size class list link
+
+    void* base;     // Address returned by the system allocator
+    size_t pages;   // Number of CHUNK_SIZE pages covered
+
+    Type type;
+    size_t slot_size;
+    size_t capacity;
+    size_t top;     // Slots handed out by bump allocation so far
+    size_t live;    // Live objects
+    bool unswept;   // Marks are from the last collection, sweep pending
+
+    size_t words;   // Length of each bitmap in 64 bit words
+    uint64_t* live_bits;
+    uint64_t* mark_bits;
+    uint64_t* old_bits;         // Survived a collection
+    uint64_t* remembered_bits;  // Listed in the remembered set
+    uint8_t* slots;
 
-    bool value : 1;
+    Object* free;
+} Chunk;
+
+// Page table entry
+typedef struct SmHeapPage {
+    uintptr_t address;
+    Chunk* chunk;
+} Page;
+
+typedef struct SmHeapMarkSegment {
+    struct SmHeapMarkSegment* prev;
+    size_t size;
+
+    struct Grey {
+        Object* obj;
+        Type type;
+    } items[SM_HEAP_MARK_SEGMENT];
+} MarkSegment;
+
+typedef enum RootKind {
+    RootDead = 0,   // Dropped out of order, reclaimed when on top
+    RootPointer,
+    RootValue
+} RootKind;
+
+typedef struct SmHeapRoot {
+    RootKind kind;
 
     union Ref {
         SmValue value;
         void* any;
     } ref;
 } Root;
+
+#define ROOT_BLOCK_SIZE 256
+
+typedef struct SmHeapRootBlock {
+    struct SmHeapRootBlock* prev;
+    size_t top;
+    Root slots[ROOT_BLOCK_SIZE];
+} RootBlock;
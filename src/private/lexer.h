@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Instruction sets the lexer scanners are implemented for
+typedef enum LexerIsa {
+    LexerScalar = 0,
+    LexerSSE2,
+    LexerAVX2,
+    LexerIsaCount
+} LexerIsa;
+
+// Byte scanners behind the lexer fast paths, working on whole blocks of
+// source at a time. Runs are counted from the start of data
+typedef struct LexerScanners {
+    // Length of the run of whitespace
+    size_t (*space)(char const* data, size_t length);
+    // Length of the run of symbol or number bytes, stopping at pipes too
+    size_t (*token)(char const* data, size_t length);
+    // Length of the run of string literal bytes, up to a quote or backslash
+    size_t (*string)(char const* data, size_t length);
+    // Number of newlines, *last is set to the index of the last one
+    size_t (*newlines)(char const* data, size_t length, size_t* last);
+    // Number of bytes starting a UTF-8 sequence
+    size_t (*utf8_starts)(char const* data, size_t length);
+} LexerScanners;
+
+// Whitespace as recognized by the lexer: isspace in the C locale
+static inline bool lexer_is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Bytes starting a UTF-8 sequence, as counted by utf8_starts
+static inline bool lexer_is_utf8_start(char c) {
+    const unsigned char b = (unsigned char) c;
+    return b < 0x80 || (b >= 0xc0 && b < 0xf8);
+}
+
+// Runs shorter than this are cheaper to count inline than through the
+// scanners
+#define LEXER_SHORT_RUN 16
+
+// Scanners for the best instruction set the CPU supports, unless another
+// one has been selected
+LexerScanners const* sm_lexer_scanners(void);
+
+// Use the scanners for isa from now on. Returns false, changing nothing,
+// if they are not available on this CPU or build
+bool sm_lexer_select(LexerIsa isa);
@@ -208,7 +208,7 @@ static void repair_after_erase(SmRBTree* tree, Node* n, Node* p) {
 
         // Update root if necessary
         if (!p->parent->parent)
-            tree->root = s;
+            tree->root = p->parent;
     }
 
     // s is still not a leaf
@@ -301,7 +301,7 @@ void* sm_rbtree_insert(SmRBTree* tree, void const* element) {
     // Find insertion point
     Node* node = tree->root;
     void* node_element = node->data + tree->node_padding;
-    int cmp = tree->compare(key, tree->key(node_element));
+    intptr_t cmp = tree->compare(key, tree->key(node_element));
 
     while ((cmp < 0 && node->left != LEAF) || (cmp > 0 && node->right != LEAF)) {
         node = (cmp < 0) ? node->left : node->right;
@@ -440,7 +440,7 @@ void* sm_rbtree_find_by_key(SmRBTree const* tree, SmKey key) {
 
     while (node != LEAF) {
         void* element = node->data + tree->node_padding;
-        int cmp = tree->compare(key, tree->key(element));
+        intptr_t cmp = tree->compare(key, tree->key(element));
 
         if (cmp == 0)
             return element;
@@ -1,34 +1,189 @@
+#include "hash.h"
 #include "symbol.h"
 
 #include <ctype.h>
 #include <string.h>
 
 // Inlines
+extern inline SmSymbolSet sm_symbol_set(void);
+extern inline size_t sm_symbol_set_size(SmSymbolSet const* set);
 extern inline SmString sm_symbol_str(SmSymbol symbol);
+extern inline SmSymbolKind sm_symbol_kind(SmSymbol symbol);
+extern inline uint32_t sm_symbol_slot(SmSymbol symbol);
+extern inline void sm_symbol_set_kind(SmSymbol symbol, SmSymbolKind kind);
+extern inline void sm_symbol_set_slot(SmSymbol symbol, uint32_t slot);
 
-void sm_symbol_set_drop(SmSymbolSet* set) {
-    for (SmString* str = (SmString*)  sm_rbtree_first(set); str; str = (SmString*) sm_rbtree_next(set, str))
-        free((char*) str->data);
+// Symbols point to the header at the start of their name, characters
+// are allocated along with it
+typedef struct SmSymbolName {
+    SmSymbolHeader header;
+    char data[];
+} Name;
+
+typedef struct SmSymbolArenaBlock {
+    struct SmSymbolArenaBlock* next;
+
+    // Aligned for names
+    union {
+        SmString str;
+        uint64_t u64;
+        void* ptr;
+    } data[];
+} Block;
 
-    sm_rbtree_drop(set);
+#define HASH_SEED 0x5f3759dfu
+#define INITIAL_CAPACITY 64
+#define ARENA_BLOCK_SIZE ((size_t) 1 << 16)
+
+// Private helpers
+static inline uint32_t name_hash(SmString str) {
+    const uint32_t hash = sm_hash_str(str, HASH_SEED);
+    return hash ? hash : 1; // 0 marks empty slots
 }
 
-SmSymbol sm_symbol(SmSymbolSet* set, SmString str) {
-    SmSymbol symbol = (SmSymbol) sm_rbtree_find(set, &str);
+static Name* arena_alloc(SmSymbolArena* arena, size_t length) {
+    const size_t align = sm_alignof(Name);
+    const size_t size = sizeof(Name) + length*sizeof(char);
+
+    char* top = arena->top;
+    if (top)
+        top += (align - ((uintptr_t) top) % align) % align;
+
+    if (!top || top > arena->end || size > (size_t) (arena->end - top)) {
+        // Oversized names get a block of their own
+        const size_t block_size = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+
+        Block* block = malloc(sizeof(Block) + block_size);
+        sm_guard(block != NULL, "allocation failed");
+
+        block->next = arena->blocks;
+        arena->blocks = block;
+
+        top = (char*) block->data;
+        arena->end = top + block_size;
+    }
+
+    arena->top = top + size;
+    return (Name*) top;
+}
+
+static inline SmSymbolKind name_kind(SmString str) {
+    if (str.length && str.data[0] == ':')
+        return SmSymbolKeyword;
+    else if (str.length == 3 && memcmp(str.data, "nil", 3) == 0)
+        return SmSymbolNil;
+    else
+        return SmSymbolPlain;
+}
 
-    if (!symbol) {
-        if (str.data && str.length > 0) {
-            char* buf = sm_aligned_alloc(16, str.length*sizeof(char));
-            strncpy(buf, str.data, str.length);
+// Find the slot holding str or the empty slot where it belongs
+static size_t set_probe(SmSymbolSet const* set, SmString str, uint32_t hash) {
+    const size_t mask = set->capacity - 1;
 
-            str.data = buf;
-        } else {
-            str.data = NULL;
-            str.length = 0;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (!set->hashes[i])
+            return i;
+
+        if (set->hashes[i] == hash && set->names[i]->header.str.length == str.length &&
+            (!str.length || memcmp(set->names[i]->header.str.data, str.data, str.length) == 0))
+        {
+            return i;
         }
+    }
+}
+
+static void set_grow(SmSymbolSet* set) {
+    const size_t capacity = set->capacity ? 2*set->capacity : INITIAL_CAPACITY;
+    uint32_t* hashes = calloc(capacity, sizeof(uint32_t));
+    Name** names = malloc(capacity*sizeof(Name*));
+    sm_guard(hashes != NULL && names != NULL, "allocation failed");
+
+    // Names are unique: reinsert without comparing
+    for (size_t i = 0; i < set->capacity; ++i) {
+        if (!set->hashes[i])
+            continue;
+
+        size_t j = set->hashes[i] & (capacity - 1);
+        while (hashes[j])
+            j = (j + 1) & (capacity - 1);
+
+        hashes[j] = set->hashes[i];
+        names[j] = set->names[i];
+    }
+
+    free(set->hashes);
+    free(set->names);
 
-        symbol = (SmSymbol) sm_rbtree_insert(set, &str);
+    set->hashes = hashes;
+    set->names = names;
+    set->capacity = capacity;
+}
+
+// Symbol set functions
+void sm_symbol_set_drop(SmSymbolSet* set) {
+    for (Block *block = set->arena.blocks, *next; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+
+    free(set->hashes);
+    free(set->names);
+
+    *set = sm_symbol_set();
+}
+
+SmSymbol sm_symbol_set_first(SmSymbolSet const* set) {
+    for (size_t i = 0; i < set->capacity; ++i)
+        if (set->hashes[i])
+            return &set->names[i]->header;
+
+    return NULL;
+}
+
+SmSymbol sm_symbol_set_next(SmSymbolSet const* set, SmSymbol symbol) {
+    Name const* name = (Name const*) symbol;
+    const size_t mask = set->capacity - 1;
+
+    size_t i = name->header.hash & mask;
+    while (set->names[i] != name)
+        i = (i + 1) & mask;
+
+    while (++i < set->capacity)
+        if (set->hashes[i])
+            return &set->names[i]->header;
+
+    return NULL;
+}
+
+// Symbol functions
+SmSymbol sm_symbol(SmSymbolSet* set, SmString str) {
+    if (!str.data)
+        str.length = 0;
+
+    const uint32_t hash = name_hash(str);
+
+    if (set->capacity) {
+        const size_t i = set_probe(set, str, hash);
+        if (set->hashes[i])
+            return &set->names[i]->header;
     }
 
-    return symbol;
+    // Keep load factor at most 1/2
+    if (2*(set->size + 1) > set->capacity)
+        set_grow(set);
+
+    Name* name = arena_alloc(&set->arena, str.length);
+    memcpy(name->data, str.data ? str.data : "", str.length*sizeof(char));
+    name->header = (SmSymbolHeader){ { str.length ? name->data : NULL, str.length }, hash, name_kind(str), 0 };
+
+    const size_t i = set_probe(set, str, hash);
+    set->hashes[i] = hash;
+    set->names[i] = name;
+    ++set->size;
+
+    return &name->header;
+}
+
+SmSymbolHeader sm_symbol_header(SmString str) {
+    return (SmSymbolHeader){ str, name_hash(str), SmSymbolPlain, 0 };
 }
@@ -0,0 +1,76 @@
+#include "rbtree.h"
+#include "symbol.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Interning as done before the hash set: a red-black tree of strings
+static SmSymbol rbtree_symbol(SmRBTree* tree, SmString str) {
+    SmSymbol symbol = (SmSymbol) sm_rbtree_find(tree, &str);
+
+    if (!symbol) {
+        char* buf = sm_aligned_alloc(16, str.length*sizeof(char));
+        memcpy(buf, str.data, str.length);
+        str.data = buf;
+
+        symbol = (SmSymbol) sm_rbtree_insert(tree, &str);
+    }
+
+    return symbol;
+}
+
+static void rbtree_symbol_drop(SmRBTree* tree) {
+    for (SmString* str = (SmString*) sm_rbtree_first(tree); str; str = (SmString*) sm_rbtree_next(tree, str))
+        free((char*) str->data);
+
+    sm_rbtree_drop(tree);
+}
+
+static double elapsed(uint64_t start) {
+    return ((double) (sm_clock_ns() - start))/1e9;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t count = (argc > 1) ? (size_t) strtoull(argv[1], NULL, 10) : 1000000;
+
+    // Identifier-like names sharing long prefixes, as in real programs
+    char* names = malloc(count*32);
+    SmString* strings = malloc(count*sizeof(SmString));
+    sm_guard(names != NULL && strings != NULL, "allocation failed");
+
+    for (size_t i = 0; i < count; ++i) {
+        const int length = snprintf(names + i*32, 32, "some-module-symbol-%zu", i);
+        strings[i] = (SmString){ names + i*32, (size_t) length };
+    }
+
+    SmSymbolSet set = sm_symbol_set();
+    uint64_t start = sm_clock_ns();
+    for (size_t i = 0; i < count; ++i)
+        sm_symbol(&set, strings[i]);
+    printf("hash set intern: %zu symbols: %.3f s\n", count, elapsed(start));
+
+    start = sm_clock_ns();
+    for (size_t i = 0; i < count; ++i)
+        sm_symbol(&set, strings[(i*7919) % count]);
+    printf("hash set lookup: %zu symbols: %.3f s\n", count, elapsed(start));
+
+    SmRBTree tree = sm_string_rbtree();
+    start = sm_clock_ns();
+    for (size_t i = 0; i < count; ++i)
+        rbtree_symbol(&tree, strings[i]);
+    printf("rbtree intern:   %zu symbols: %.3f s\n", count, elapsed(start));
+
+    start = sm_clock_ns();
+    for (size_t i = 0; i < count; ++i)
+        rbtree_symbol(&tree, strings[(i*7919) % count]);
+    printf("rbtree lookup:   %zu symbols: %.3f s\n", count, elapsed(start));
+
+    rbtree_symbol_drop(&tree);
+    sm_symbol_set_drop(&set);
+
+    free(strings);
+    free(names);
+
+    return 0;
+}
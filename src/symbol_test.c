@@ -0,0 +1,77 @@
+#include "symbol.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char* argv[]) {
+    SmTestContext ctx = sm_test_context(argc, argv);
+
+    SmSymbolSet set = sm_symbol_set();
+
+    sm_test(&ctx, "sm_symbol_set should create an empty set",
+        sm_symbol_set_size(&set) == 0 && sm_symbol_set_first(&set) == NULL);
+
+    // Interning must not depend on the address of the source string
+    char buf[] = "lambda";
+    SmSymbol lambda = sm_symbol(&set, sm_string_from_cstring("lambda"));
+    SmSymbol same = sm_symbol(&set, sm_string_from_cstring(buf));
+    SmSymbol other = sm_symbol(&set, sm_string_from_cstring("lambdas"));
+    SmSymbol prefix = sm_symbol(&set, (SmString){ buf, 3 });
+
+    sm_test(&ctx, "sm_symbol should return the same symbol for equal strings", lambda == same);
+    sm_test(&ctx, "sm_symbol should return different symbols for different strings",
+        lambda != other && lambda != prefix && other != prefix);
+    sm_test(&ctx, "sm_symbol_str should return a copy of the interned string",
+        sm_symbol_str(prefix).length == 3 && memcmp(sm_symbol_str(prefix).data, "lam", 3) == 0 &&
+        sm_symbol_str(prefix).data != buf);
+
+    SmSymbol empty = sm_symbol(&set, (SmString){ NULL, 0 });
+    sm_test(&ctx, "sm_symbol should intern the empty string",
+        empty == sm_symbol(&set, sm_string_from_cstring("")) && sm_symbol_str(empty).length == 0);
+
+    sm_test(&ctx, "sm_symbol should classify nil and keywords",
+        sm_symbol_kind(sm_symbol(&set, sm_string_from_cstring("nil"))) == SmSymbolNil &&
+        sm_symbol_kind(sm_symbol(&set, sm_string_from_cstring(":key"))) == SmSymbolKeyword &&
+        sm_symbol_kind(sm_symbol(&set, sm_string_from_cstring("nils"))) == SmSymbolPlain &&
+        sm_symbol_kind(lambda) == SmSymbolPlain && sm_symbol_kind(empty) == SmSymbolPlain);
+
+    sm_symbol_set_kind(lambda, SmSymbolExternalFunction);
+    sm_test(&ctx, "sm_symbol_set_kind should be visible through every reference to the symbol",
+        sm_symbol_kind(sm_symbol(&set, sm_string_from_cstring("lambda"))) == SmSymbolExternalFunction);
+
+    // Grow the set well past its initial capacity
+    const size_t count = 100000;
+    bool stable = true;
+    for (size_t i = 0; i < count; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "symbol-%zu", i);
+        sm_symbol(&set, sm_string_from_cstring(name));
+    }
+
+    for (size_t i = 0; i < count; i += 997) {
+        char name[32];
+        snprintf(name, sizeof(name), "symbol-%zu", i);
+
+        SmSymbol symbol = sm_symbol(&set, sm_string_from_cstring(name));
+        stable = stable && sm_symbol_str(symbol).length == strlen(name) &&
+            memcmp(sm_symbol_str(symbol).data, name, strlen(name)) == 0;
+    }
+
+    sm_test(&ctx, "symbols should survive growth of the set",
+        stable && lambda == sm_symbol(&set, sm_string_from_cstring("lambda")));
+    sm_test(&ctx, "sm_symbol_set_size should count distinct symbols",
+        sm_symbol_set_size(&set) == count + 7);
+
+    size_t visited = 0;
+    for (SmSymbol symbol = sm_symbol_set_first(&set); symbol; symbol = sm_symbol_set_next(&set, symbol))
+        ++visited;
+
+    sm_test(&ctx, "sm_symbol_set_first and sm_symbol_set_next should visit every symbol once",
+        visited == sm_symbol_set_size(&set));
+
+    sm_symbol_set_drop(&set);
+
+    return !sm_test_report(&ctx);
+}
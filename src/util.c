@@ -1,8 +1,18 @@
+// Needed for clock_gettime and getrlimit under strict C99
+#if !defined(_POSIX_C_SOURCE) && (defined(__unix__) || defined(__APPLE__))
+    #define _POSIX_C_SOURCE 200112L
+#endif
+
 #include "util.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
 
 // Inlines
 extern inline intptr_t sm_key_compare_ptr(SmKey lhs, SmKey rhs);
@@ -11,6 +21,9 @@ extern inline SmKey sm_ptr_key(void const* element);
 extern inline SmString sm_string_from_cstring(char const* str);
 extern inline SmKey sm_string_key(void const* element);
 extern inline void* sm_aligned_alloc(size_t alignment, size_t size);
+extern inline unsigned int sm_ctz64(uint64_t v);
+extern inline unsigned int sm_clz64(uint64_t v);
+extern inline unsigned int sm_popcount64(uint64_t v);
 extern inline SmTestContext sm_test_context(int argc, char** argv);
 
 // Private helpers
@@ -50,6 +63,31 @@ size_t sm_common_alignment(size_t a1, size_t a2) {
     return (a1*a2)/gcd_size_t(a1, a2);
 }
 
+// Timing
+uint64_t sm_clock_ns(void) {
+    #if defined(CLOCK_MONOTONIC)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec)*UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+    #else
+        // Processor time is the best C99 offers
+        return (uint64_t) ((((double) clock())/CLOCKS_PER_SEC)*1e9);
+    #endif
+}
+
+size_t sm_stack_size(void) {
+    #if defined(__unix__) || defined(__APPLE__)
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+            limit.rlim_cur <= SIZE_MAX)
+        {
+            return (size_t) limit.rlim_cur;
+        }
+    #endif
+
+    return SM_STACK_SIZE;
+}
+
 // Testing
 bool sm_test(SmTestContext* ctx, char const* desc, bool result) {
     ctx->pass += result;
@@ -7,20 +7,23 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // Inlines
 extern inline SmValue sm_value_nil();
 extern inline SmValue sm_value_number(SmNumber number);
 extern inline SmValue sm_value_symbol(SmSymbol symbol);
-extern inline SmValue sm_value_string(SmString view);
+extern inline SmValue sm_value_string(SmStringHeader const* string);
 extern inline SmValue sm_value_cons(SmCons* cons);
 extern inline SmValue sm_value_function(SmFunction* function);
+extern inline SmValue sm_value_external(SmSymbol symbol);
 extern inline bool sm_value_is_nil(SmValue value);
 extern inline bool sm_value_is_number(SmValue value);
 extern inline bool sm_value_is_symbol(SmValue value);
 extern inline bool sm_value_is_string(SmValue value);
 extern inline bool sm_value_is_cons(SmValue value);
 extern inline bool sm_value_is_function(SmValue value);
+extern inline bool sm_value_is_external(SmValue value);
 extern inline bool sm_value_is_quoted(SmValue value);
 extern inline SmValue sm_value_quote(SmValue value, uint8_t quotes);
 extern inline SmValue sm_value_unquote(SmValue value, uint8_t unquotes);
@@ -78,11 +81,8 @@ static inline char const* escape_char(char chr) {
     }
 }
 
-// Debug helper
-void sm_print_value(FILE* f, SmValue value) {
-    for (uint8_t i = 0; i < value.quotes; ++i)
-        fprintf(f, "\'");
-
+// Print anything but lists and function bodies
+static void print_atom(FILE* f, SmValue value) {
     SmString str;
 
     switch (value.type) {
@@ -112,7 +112,7 @@ void sm_print_value(FILE* f, SmValue value) {
 
         case SmTypeString:
             fprintf(f, "\"");
-            for (char const *p = value.data.string.data, *end = p + value.data.string.length;
+            for (char const *p = value.data.string->str.data, *end = p + value.data.string->str.length;
                  p != end; ++p)
             {
                 char const* esc = escape_char(*p);
@@ -124,28 +124,6 @@ void sm_print_value(FILE* f, SmValue value) {
             fprintf(f, "\"");
             break;
 
-        case SmTypeCons:
-            fprintf(f, "(");
-
-            sm_print_value(f, value.data.cons->car);
-            if (!sm_value_is_list(value.data.cons->cdr) || sm_value_is_quoted(value.data.cons->cdr)) {
-                fprintf(f, " . ");
-                sm_print_value(f, value.data.cons->cdr);
-            }
-
-            for (SmCons* cons = sm_list_next(value.data.cons); cons; cons = sm_list_next(cons)) {
-                fprintf(f, " ");
-                sm_print_value(f, cons->car);
-
-                if (!sm_value_is_list(cons->cdr) || sm_value_is_quoted(cons->cdr)) {
-                    fprintf(f, " . ");
-                    sm_print_value(f, cons->cdr);
-                }
-            }
-
-            fprintf(f, ")");
-            break;
-
         case SmTypeFunction:
             fprintf(f, "(%s ", value.data.function->macro ? "macro" : "lambda");
             if (value.data.function->args.count > 0 || !value.data.function->args.rest.use)
@@ -174,13 +152,11 @@ void sm_print_value(FILE* f, SmValue value) {
 
             if (value.data.function->args.count > 0 || !value.data.function->args.rest.use)
                 fprintf(f, ")");
+            break;
 
-            for (SmCons* cons = value.data.function->progn; cons; cons = sm_list_next(cons)) {
-                fprintf(f, " ");
-                sm_print_value(f, cons->car);
-            }
-
-            fprintf(f, ")");
+        case SmTypeExternal:
+            str = sm_symbol_str(value.data.symbol);
+            fprintf(f, "<external:%.*s>", (int) str.length, str.data);
             break;
 
         default:
@@ -188,6 +164,79 @@ void sm_print_value(FILE* f, SmValue value) {
     }
 }
 
+// List being printed: cons holds the element printed last, tail is set
+// once the dotted tail has been printed
+typedef struct PrintList {
+    SmCons* cons;
+    bool tail;
+} PrintList;
+
+// Debug helper
+void sm_print_value(FILE* f, SmValue value) {
+    // Open lists, innermost last: nesting is bounded by memory, not by the
+    // native stack
+    PrintList* lists = NULL;
+    size_t size = 0, capacity = 0;
+
+    while (true) {
+        for (uint8_t i = 0; i < value.quotes; ++i)
+            fprintf(f, "\'");
+
+        SmCons* list = NULL;
+
+        if (value.type == SmTypeCons) {
+            fprintf(f, "(");
+            list = value.data.cons;
+        } else {
+            print_atom(f, value);
+
+            // Function bodies are printed as the rest of a list
+            if (value.type == SmTypeFunction) {
+                list = value.data.function->progn;
+                fprintf(f, list ? " " : ")");
+            }
+        }
+
+        if (list) {
+            if (size == capacity) {
+                capacity = capacity ? 2*capacity : 16;
+                lists = realloc(lists, capacity*sizeof(PrintList));
+                sm_guard(lists != NULL, "allocation failed");
+            }
+
+            lists[size++] = (PrintList){ list, false };
+            value = list->car;
+            continue;
+        }
+
+        // Move to the next element, closing the lists that are done
+        while (size > 0) {
+            PrintList* top = &lists[size - 1];
+            SmValue cdr = top->cons->cdr;
+
+            if (top->tail || (sm_value_is_nil(cdr) && !sm_value_is_quoted(cdr))) {
+                fprintf(f, ")");
+                --size;
+            } else if (!sm_value_is_list(cdr) || sm_value_is_quoted(cdr)) {
+                fprintf(f, " . ");
+                top->tail = true;
+                value = cdr;
+                break;
+            } else {
+                fprintf(f, " ");
+                top->cons = cdr.data.cons;
+                value = top->cons->car;
+                break;
+            }
+        }
+
+        if (size == 0)
+            break;
+    }
+
+    free(lists);
+}
+
 // List functions
 void sm_list_copy(SmContext* ctx, SmCons* cons, SmValue* ret) {
     if (!cons) {
@@ -204,6 +253,7 @@ void sm_list_copy(SmContext* ctx, SmCons* cons, SmValue* ret) {
 
     for (cons = sm_list_next(cons); cons; cons = sm_list_next(cons)) {
         copy->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+        sm_heap_write_barrier(&ctx->heap, copy);
         copy = copy->cdr.data.cons;
 
         copy->car = cons->car;
@@ -218,6 +268,7 @@ void build_list_v(SmContext* ctx, SmValue* ret, va_list* args) {
 
     if (op == SmBuildCdr) {
         *ret = va_arg(*args, SmValue);
+        sm_heap_write_barrier(&ctx->heap, ret);
         return;
     } else if (op == SmBuildEnd) {
         *ret = sm_value_nil();
@@ -227,6 +278,9 @@ void build_list_v(SmContext* ctx, SmValue* ret, va_list* args) {
     SmCons* cons = sm_heap_alloc_cons(&ctx->heap, ctx);
     *ret = sm_value_cons(cons); // Save head
 
+    // Nested lists are built in place: ret may point into an old cons
+    sm_heap_write_barrier(&ctx->heap, ret);
+
     if (op == SmBuildCar)
         cons->car = va_arg(*args, SmValue);
     else if (op == SmBuildList)
@@ -238,6 +292,7 @@ void build_list_v(SmContext* ctx, SmValue* ret, va_list* args) {
     {
         // Continue list
         cons->cdr = sm_value_cons(sm_heap_alloc_cons(&ctx->heap, ctx));
+        sm_heap_write_barrier(&ctx->heap, cons);
         cons = sm_list_next(cons);
 
         if (op == SmBuildCar)
@@ -249,6 +304,7 @@ void build_list_v(SmContext* ctx, SmValue* ret, va_list* args) {
     }
 
     cons->cdr = (op == SmBuildCdr) ? va_arg(*args, SmValue) : sm_value_nil();
+    sm_heap_write_barrier(&ctx->heap, cons);
 }
 
 void sm_build_list(SmContext* ctx, SmValue* ret, ...) {